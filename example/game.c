@@ -40,12 +40,16 @@ int fc_game_init (fc_game_t *game)
 	}
 	fc_board_init(game->board);
 	game->player = FC_NONE;
+	game->keys = NULL;
+	game->num_keys = 0;
+	game->max_keys = 0;
 	return 1;
 }
 
 void fc_game_free (fc_game_t *game)
 {
 	free(game->board);
+	free(game->keys);
 }
 
 static void remove2position (char *str, uint64_t pos)
@@ -127,6 +131,7 @@ int fc_game_save (fc_game_t *game, const char *filename)
 int fc_game_load (fc_game_t *game, const char *filename)
 {
 	bzero(game->board->bitb, sizeof(game->board->bitb));
+	game->num_keys = 0;
 	return fc_board_setup(game->board, filename, &(game->player));
 }
 
@@ -225,9 +230,61 @@ int fc_game_is_over (fc_game_t *game)
 		 	!FC_BITBOARD(game->board, FC_FOURTH, FC_KING)));
 }
 
+/*
+ * Remembers the position before a move.  A move that cannot be undone makes
+ * every earlier position impossible to reach again, so they are forgotten.
+ */
+static int add_position (fc_game_t *game, uint64_t key, fc_move_t *move)
+{
+	uint64_t *keys;
+
+	if (!fc_move_is_reversible(move)) {
+		game->num_keys = 0;
+		return 1;
+	}
+	if (game->num_keys == game->max_keys) {
+		keys = realloc(game->keys, (game->max_keys * 2 + 16) *
+				sizeof(uint64_t));
+		if (!keys) {
+			return 0;
+		}
+		game->keys = keys;
+		game->max_keys = game->max_keys * 2 + 16;
+	}
+	game->keys[game->num_keys++] = key;
+	return 1;
+}
+
 int fc_game_make_move (fc_game_t *game, fc_move_t *move)
 {
-	return fc_board_make_move(game->board, move);
+	uint64_t key;
+
+	key = fc_ai_node_key(game->board, move->player);
+	if (!fc_board_make_move(game->board, move)) {
+		return 0;
+	}
+	return add_position(game, key, move);
+}
+
+int fc_game_repetitions (fc_game_t *game)
+{
+	int i, count;
+	uint64_t key;
+
+	key = fc_ai_node_key(game->board, game->player);
+	count = 0;
+	for (i = 0; i < game->num_keys; i++) {
+		if (game->keys[i] == key) {
+			count += 1;
+		}
+	}
+	return count;
+}
+
+int fc_game_get_played_positions (fc_game_t *game, const uint64_t **keys)
+{
+	*keys = game->keys;
+	return game->num_keys;
 }
 
 void fc_game_set_promote_pawn (fc_move_t *move, fc_piece_t promote)
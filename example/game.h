@@ -45,6 +45,9 @@
 typedef struct {
 	fc_player_t player;
 	fc_board_t *board;
+	uint64_t *keys; /* positions since the last irreversible move */
+	int num_keys;
+	int max_keys;
 } fc_game_t;
 
 #endif /* DOXYGEN_IGNORE */
@@ -200,8 +203,9 @@ int fc_game_is_over (fc_game_t *game);
 /**
  * @brief Update the game with the new move.
  *
- * @remark Simply calls fc_board_make_move(), so please see its documentation
- * for details.
+ * @remark Calls fc_board_make_move(), so please see its documentation for
+ * details.  The position before the move is remembered for
+ * fc_game_repetitions().
  *
  * @param[in,out] game A pointer to the game.
  * @param[in] move The move to make.
@@ -210,6 +214,32 @@ int fc_game_is_over (fc_game_t *game);
  */
 int fc_game_make_move (fc_game_t *game, fc_move_t *move);
 
+/**
+ * @brief Returns the number of times the current position has come up before.
+ *
+ * Positions count as the same only if the same player is to move.  Captures,
+ * removes and pawn moves can never be undone, so only the positions since the
+ * last of those are counted.
+ *
+ * @param[in] game A pointer to the game.
+ *
+ * @return The number of earlier occurrences of the current position.
+ */
+int fc_game_repetitions (fc_game_t *game);
+
+/**
+ * @brief Returns the positions played that might still come up again.
+ *
+ * These are the keys to hand to fc_ai_set_played_positions(), so that the
+ * AI can avoid (or seek out) repeating them.
+ *
+ * @param[in] game A pointer to the game.
+ * @param[out] keys Set to the keys of the positions, oldest first.
+ *
+ * @return The number of keys.
+ */
+int fc_game_get_played_positions (fc_game_t *game, const uint64_t **keys);
+
 /**
  * @brief Sets the piece that the pawn should be promoted to with the given
  * move.
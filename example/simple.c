@@ -19,6 +19,9 @@ void make_computer_move (fc_game_t *game, fc_player_t player, int depth,
 void get_time (char *str, time_t t);
 void move2str (fc_game_t *game, char *str, fc_move_t *move);
 
+/* one AI plays all of the computer players, so it is kept for the whole game */
+fc_ai_t ai;
+
 int get_arguments (int argc, char **argv, char *file, int *depth, int *timeout)
 {
 	int c;
@@ -98,9 +101,15 @@ int main (int argc, char **argv)
 		exit(1);
 	}
 
+	fc_ai_init(&ai, fc_game_get_board(&game));
 	for (fc_player_t player = fc_game_current_player(&game);
 	     !fc_game_is_over(&game);
 	     player = fc_game_next_player(&game)) {
+		int repeats = fc_game_repetitions(&game);
+		if (repeats > 0) {
+			printf("(position repeated %d time%s)\n", repeats,
+					(repeats > 1) ? "s" : "");
+		}
 		if (player_is_human[player]) {
 			query_human_for_move(&game, player);
 		} else {
@@ -108,6 +117,7 @@ int main (int argc, char **argv)
 		}
 	}
 
+	fc_ai_free(&ai);
 	fc_game_free(&game);
 	return 0;
 }
@@ -187,16 +197,16 @@ void get_best_move (fc_game_t *game, fc_move_t *move, fc_player_t player,
 {
 	int rc;
 	fc_mlist_t *tmp = NULL;
-	fc_ai_t ai;
+	const uint64_t *keys;
+	int count = fc_game_get_played_positions(game, &keys);
+	fc_ai_set_played_positions(&ai, keys, count);
 	if (depth > fc_game_number_of_players(game) * 2) {
 		tmp = calloc(1, sizeof(fc_mlist_t));
 		fc_mlist_init(tmp);
-		fc_ai_init(&ai, fc_game_get_board(game));
 		rc = fc_ai_next_ranked_moves(&ai, tmp, NULL, player,
 				fc_game_number_of_players(game) * 2, 0);
 		assert(rc);
 	}
-	fc_ai_init(&ai, fc_game_get_board(game));
 	rc = fc_ai_next_move(&ai, move, tmp, player, depth, timeout);
 	assert(rc);
 	if (tmp) {
@@ -35,24 +35,110 @@
 
 typedef enum {
 	FC_ALPHABETA,
-	FC_NEGASCOUT
+	FC_NEGASCOUT,
+	FC_BRS,
+	FC_MCTS,
+	FC_MAXN,
+	FC_MTDF
 } fc_ai_algo_t;
 
+/*
+ * The score of a position in which the opposing team has been eliminated.
+ * The number of plies it takes to get there is subtracted from the score, so
+ * any score within FC_AI_MAX_PV of FC_AI_WIN_SCORE is a forced win (and its
+ * negation a forced loss).
+ */
+#define FC_AI_WIN_SCORE 10000000
+
+/* the longest principal variation remembered between searches */
+#define FC_AI_MAX_PV 64
+
+/* results of fc_ai_solve() */
+#define FC_SOLVE_UNKNOWN 0
+#define FC_SOLVE_PROVEN 1
+#define FC_SOLVE_DISPROVEN 2
+
+/* the longest line that fc_ai_solve() will look down */
+#define FC_SOLVE_MAX_PLIES 64
+
+typedef struct fc_ai_thread_ fc_ai_thread_t;
+
+typedef struct fc_ai_slice_ fc_ai_slice_t;
+
+typedef struct fc_ai_entry_ fc_ai_entry_t;
+
+typedef void (*fc_ai_progress_t) (void *data, int depth, int score,
+		unsigned long nodes, fc_move_t *move);
+
 typedef struct {
 	fc_board_t *board;
 	fc_board_t *bv; /* board vector */
 	fc_mlist_t *mlv; /* move list vector */
+	fc_move_t *pvt; /* triangular principal variation table */
+	int *pvl; /* principal variation lengths */
+	int depth; /* height of the stacks for the current search */
+	int follow_pv; /* still on the principal variation of the last search */
+	fc_move_t pv[FC_AI_MAX_PV]; /* best line found by the last search */
+	int pv_length;
+	fc_board_t pv_board; /* position that pv starts from */
+	int maxsum; /* bound on the sum of the FC_MAXN scores */
 	time_t timeout;
 	fc_ai_algo_t algo;
+	unsigned long playouts; /* FC_MCTS playout budget */
+	unsigned long msecs; /* FC_MCTS time budget */
+	int threads;
+	unsigned long node_limit; /* 0 if there is no limit */
+	unsigned long nodes; /* nodes searched by the last search */
+	int stopped; /* the last search ran out of nodes or time */
+	unsigned long clock; /* milliseconds left on the game clock */
+	unsigned long increment; /* milliseconds added to the clock per move */
+	int moves_to_go; /* moves until the next time control; 0 if unknown */
+	long deadline; /* hard time limit of the search in milliseconds */
+	int forced; /* the last move was returned without a search */
+	int forced_moves; /* see fc_ai_set_forced_moves() */
+	fc_ai_thread_t *thread; /* the background thread running this AI */
+	fc_ai_thread_t *ponder; /* the search started by fc_ai_ponder() */
+	fc_ai_thread_t *search; /* the search started by fc_ai_search_start() */
+	fc_ai_slice_t *slice; /* the search started by fc_ai_slice_start() */
+	fc_ai_progress_t progress;
+	void *progress_data;
+	int stack_depth; /* the depth that bv, mlv and pvt are sized for */
+	fc_ai_entry_t *hash; /* the FC_NEGASCOUT transposition table */
+	unsigned long hash_size; /* number of entries; a power of two */
+	unsigned long hash_memory; /* bytes to allocate for the table */
+	int age; /* counts the moves searched; ages the table */
+	fc_move_t killers[FC_AI_MAX_PV][2]; /* quiet cutoff moves by ply */
+	int32_t history[FC_NUM_PLAYERS][FC_NUM_PIECES][64]; /* by square */
+	uint64_t *keys; /* the played positions, then the search line */
+	int *reversible; /* see is_repetition() */
+	int keys_size;
+	int played; /* the number of played positions in keys */
+	fc_player_t seat[FC_NUM_PLAYERS]; /* see next_seat() */
+	int pseudo_legal; /* see fc_ai_set_pseudo_legal() */
+	int futility; /* see fc_ai_set_futility() */
+	int beam_opponent; /* see fc_ai_set_beam() */
+	int beam_partner;
+	fc_player_t player; /* the player to move at the root of the search */
+	int guess[FC_NUM_PLAYERS]; /* FC_MTDF's first guesses (see mtdf()) */
 } fc_ai_t;
 
+
+int fc_ai_mcts (fc_ai_t *ai, fc_mlist_t *ret, fc_mlist_t *given,
+		fc_player_t player, int depth);
+
+int fc_ai_thread_stopping (fc_ai_thread_t *t);
+
+int fc_ai_collect_ponder (fc_ai_t *ai, fc_player_t player, fc_mlist_t *list);
+
 #endif /* DOXYGEN_IGNORE */
 
 /**
  * @brief Initializes the AI structure.
  *
  * Sets the given board for the AI and initializes the default piece material
- * values.
+ * values.  The AI structure is meant to be kept for the whole game:  what it
+ * learns while searching for one move (see fc_ai_set_hash_size()) carries
+ * over to the next.  Call fc_ai_free() when done with it.
  *
  * @param[in,out] ai A pointer to the AI structure.
  * @param[in,out] ai A pointer to the game board.
@@ -61,9 +147,406 @@ typedef struct {
  */
 void fc_ai_init (fc_ai_t *ai, fc_board_t *board);
 
+/**
+ * @brief Frees the memory held by the AI structure.
+ *
+ * Stops any search still running in the background first.  The structure
+ * may be used again after another call to fc_ai_init().
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ *
+ * @return void
+ */
+void fc_ai_free (fc_ai_t *ai);
+
+/**
+ * @brief Returns the key of a position with the given player to move.
+ *
+ * Two positions with different keys are never the same position (or are the
+ * same position with different players to move).  The same key may, on rare
+ * occasions, be shared by two different positions.  A key is never 0.
+ *
+ * @param[in] board A pointer to the game board.
+ * @param[in] player The player to move.
+ *
+ * @return The key of the position.
+ */
+uint64_t fc_ai_node_key (fc_board_t *board, fc_player_t player);
+
+/**
+ * @brief Tells the AI which positions have already come up in the game.
+ *
+ * A position that repeats one of these, or one earlier along the line being
+ * searched, is scored as even instead of being searched again.  keys holds
+ * the fc_ai_node_key() of each position played, oldest first, with the
+ * player who moved from it.  Only the positions since the last move that was
+ * not reversible (see fc_move_is_reversible()) are needed, and the current
+ * position is left out.  The keys are copied, and are used by every search
+ * until they are set again.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] keys The keys of the played positions.
+ * @param[in] count The number of keys; 0 to forget the played positions.
+ *
+ * @return void
+ */
+void fc_ai_set_played_positions (fc_ai_t *ai, const uint64_t *keys,
+		int count);
+
+/**
+ * @brief Sets the memory used by the transposition table.
+ *
+ * FC_NEGASCOUT (and FC_MTDF, which runs on it) remembers the positions it
+ * has searched, with their scores and best moves, in a table that is kept
+ * from one move to the next.  It also
+ * keeps the quiet moves that caused cutoffs, to try them early elsewhere.
+ * Entries left by the searches of earlier moves are the first to be
+ * replaced.  The default size is 2MB.  Changing the size clears the table.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] bytes The size of the table in bytes; 0 for the default.
+ *
+ * @return void
+ */
+void fc_ai_set_hash_size (fc_ai_t *ai, unsigned long bytes);
+
+/**
+ * @brief Lets the search work on pseudo-legal moves.
+ *
+ * Normally every move that FC_NEGASCOUT tries is checked for validity
+ * (see fc_board_is_move_valid()) before it is made.  In pseudo-legal mode,
+ * the moves below the root are made as they are generated, and a move that
+ * leaves the player's king in check, or puts the partner's king in check, is
+ * thrown out afterwards with a cheap test of the position it led to.  A
+ * player who is in check, or who turns out to have no valid move and has to
+ * remove a piece instead, gets the full checks, as do the moves at the root.
+ * The search finds the same moves and scores either way; the mode is off by
+ * default.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] on 1 to search pseudo-legal moves; 0 for the full checks.
+ *
+ * @return void
+ */
+void fc_ai_set_pseudo_legal (fc_ai_t *ai, int on);
+
+/**
+ * @brief Turns futility pruning and razoring on or off.
+ *
+ * Near the leaves, FC_NEGASCOUT skips the quiet moves of a position whose
+ * static score is too far below the best score found so far for a quiet
+ * move to catch up:  one ply from the leaves by more than a pawn, and two
+ * plies from them by more than a rook, in which case only the captures are
+ * searched.  The margins follow the material values (see
+ * fc_board_set_material_value()).  Pruning is on by default; turning it off
+ * searches every move.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] on 1 to prune; 0 to search every move.
+ *
+ * @return void
+ */
+void fc_ai_set_futility (fc_ai_t *ai, int on);
+
+/**
+ * @brief Narrows the search at the other players' turns.
+ *
+ * In beam mode, FC_NEGASCOUT searches only the first moves in its move
+ * order (the hash and principal variation moves, then the captures, the
+ * killers and the history) at the plies of the opponents and the partner of
+ * the player it is searching for.  His own plies are searched to full width.
+ * The replies are only approximate, but the tree is much smaller.  A width
+ * of 0 searches every move, which is the default.  The transposition table
+ * is emptied when the widths change, and in beam mode the positions searched
+ * for different players are stored apart.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] opponent The most moves searched at an opponent's ply.
+ * @param[in] partner The most moves searched at the partner's ply.
+ *
+ * @return void
+ */
+void fc_ai_set_beam (fc_ai_t *ai, int opponent, int partner);
+
 /* TODO */
 void fc_ai_set_algorithm (fc_ai_t *ai, fc_ai_algo_t algo);
 
+/**
+ * @brief Sets the budget of the FC_MCTS algorithm.
+ *
+ * The Monte Carlo search keeps running playouts until either budget is spent
+ * (or the seconds passed to fc_ai_next_move() expire).  A budget of 0 means
+ * no limit.  If no limit is set at all, then a default number of playouts is
+ * run.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] playouts The maximum number of playouts.
+ * @param[in] msecs The maximum number of milliseconds to search.
+ *
+ * @return void
+ */
+void fc_ai_set_mcts_budget (fc_ai_t *ai, unsigned long playouts,
+		unsigned long msecs);
+
+/**
+ * @brief Sets the number of threads the AI may search with.
+ *
+ * Only FC_MCTS searches in parallel; the threads share a single tree.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] threads The number of threads (including the calling thread).
+ *
+ * @return void
+ */
+void fc_ai_set_threads (fc_ai_t *ai, int threads);
+
+/**
+ * @brief Limits the number of nodes that a search may visit.
+ *
+ * Once the limit is reached, the search stops just as it would when its time
+ * runs out, and the best move found so far is returned.  Unlike a time limit,
+ * a node limit gives the same result on any machine.  FC_MCTS is limited by
+ * fc_ai_set_mcts_budget() instead.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] nodes The maximum number of nodes; 0 means no limit.
+ *
+ * @return void
+ */
+void fc_ai_set_node_limit (fc_ai_t *ai, unsigned long nodes);
+
+/**
+ * @brief Returns the number of nodes visited by the last search.
+ *
+ * Every position entered by the search counts as a node, including the
+ * positions of the capture-only search.  FC_MCTS does not count nodes.
+ *
+ * @param[in] ai A pointer to the AI structure.
+ *
+ * @return The number of nodes visited.
+ */
+unsigned long fc_ai_get_nodes (fc_ai_t *ai);
+
+/**
+ * @brief Returns 1 if the last move needed no search; 0 otherwise.
+ *
+ * Before searching, fc_ai_next_move() checks whether the player has only one
+ * legal move (or one piece to remove), or can capture a king and end the
+ * game.  If so, that move is returned at once as the only ranked move.
+ *
+ * @param[in] ai A pointer to the AI structure.
+ *
+ * @return 1 if the last move was forced; 0 otherwise
+ */
+int fc_ai_was_forced (fc_ai_t *ai);
+
+/**
+ * @brief Turns the check for forced moves on or off.
+ *
+ * With the check off, the moves that fc_ai_was_forced() describes are
+ * searched like any other, and are ranked with the rest of the moves.  The
+ * check is on by default.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] on 1 to return forced moves without a search; 0 to search them.
+ *
+ * @return void
+ */
+void fc_ai_set_forced_moves (fc_ai_t *ai, int on);
+
+/**
+ * @brief Sets the game clock of the player the AI is searching for.
+ *
+ * With a clock set, fc_ai_next_move() searches one ply deeper at a time, up to
+ * the depth it is given, and decides for itself when to stop.  The time for
+ * the move comes out of the clock:  each move gets a share of the remaining
+ * time (and most of the increment), spread over the moves to go, and more if
+ * the best move keeps changing from one depth to the next.  If moves_to_go is
+ * 0, then it is estimated from the number of players still in the game.  The
+ * clock is not run down by the AI, so it should be set again before every
+ * move.  A clock of 0 turns the time manager off.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] msecs The milliseconds left on the clock.
+ * @param[in] increment The milliseconds added to the clock after each move.
+ * @param[in] moves_to_go The number of moves to make before the next time
+ * control; 0 if unknown.
+ *
+ * @return void
+ */
+void fc_ai_set_clock (fc_ai_t *ai, unsigned long msecs,
+		unsigned long increment, int moves_to_go);
+
+/**
+ * @brief Thinks about the player's next move while the opponents move.
+ *
+ * Call this right after the player's move has been made on the board.  A
+ * background thread plays out the moves that the last search predicted for
+ * the other players (searching for any move it did not predict) and then
+ * searches the resulting position for player, one ply deeper at a time, up to
+ * depth.  The next call to fc_ai_next_move() for player stops the thread.  If
+ * the board then matches the predicted position, the search goes on one ply
+ * deeper at a time from the deepest finished ponder search (and returns its
+ * result at once if it is deep enough); otherwise the ponder search's moves
+ * are thrown away.  Either way, what it stored in the transposition table is
+ * kept.
+ *
+ * The thread works on a copy of the board, so the opponents' moves may be
+ * made on the board while it runs.  It takes the AI's transposition table
+ * and history with it, and hands them back when it is stopped.
+ * fc_ai_stop_pondering() must be called before the AI is thrown away.
+ * FC_MCTS does not ponder.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] player The player the AI is playing for.
+ * @param[in] depth The deepest search to ponder.
+ *
+ * @return 1 if the thread was started; 0 otherwise
+ */
+int fc_ai_ponder (fc_ai_t *ai, fc_player_t player, int depth);
+
+/**
+ * @brief Returns how deep the ponder thread has searched so far.
+ *
+ * @param[in] ai A pointer to the AI structure.
+ *
+ * @return The depth of the deepest finished ponder search; 0 if there is none
+ * or the AI is not pondering
+ */
+int fc_ai_ponder_depth (fc_ai_t *ai);
+
+/**
+ * @brief Stops the ponder thread and throws its moves away.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ *
+ * @return void
+ */
+void fc_ai_stop_pondering (fc_ai_t *ai);
+
+/**
+ * @brief Sets a function to be called after each finished depth of a search.
+ *
+ * The searches that deepen one ply at a time (those run with a game clock,
+ * see fc_ai_set_clock(), those run in the background, see
+ * fc_ai_search_start(), and those that pick up a ponder search, see
+ * fc_ai_ponder()) call progress with data, the depth just finished, the
+ * score and the best move at that depth, and the number of nodes searched so
+ * far.  In the background, progress is called from the search thread.
+ *
+ * The type of progress is:
+ * @code
+ * void (*fc_ai_progress_t) (void *data, int depth, int score,
+ *		unsigned long nodes, fc_move_t *move);
+ * @endcode
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] progress The function to call, or NULL for none.
+ * @param[in] data Passed through to progress.
+ *
+ * @return void
+ */
+void fc_ai_set_progress (fc_ai_t *ai, fc_ai_progress_t progress, void *data);
+
+/**
+ * @brief Starts a search in a background thread and returns at once.
+ *
+ * The search deepens one ply at a time up to depth, so it can be stopped at
+ * any point with the best move of the deepest finished search.  It runs on the
+ * AI structure, which must not be used (other than with the fc_ai_search_*()
+ * functions) until fc_ai_search_wait() returns.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] player The player we are finding the best move for.
+ * @param[in] depth The deepest search.
+ * @param[in] seconds A time limit as in fc_ai_next_move(); 0 for none.
+ *
+ * @return 1 if the search was started; 0 otherwise
+ */
+int fc_ai_search_start (fc_ai_t *ai, fc_player_t player, int depth,
+		unsigned int seconds);
+
+/**
+ * @brief Returns 1 if the background search has finished; 0 otherwise.
+ *
+ * @param[in] ai A pointer to the AI structure.
+ *
+ * @return 1 if fc_ai_search_wait() will not block; 0 otherwise
+ */
+int fc_ai_search_poll (fc_ai_t *ai);
+
+/**
+ * @brief Asks the background search to stop as soon as it can.
+ *
+ * Returns without waiting; may be called from any thread.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ *
+ * @return void
+ */
+void fc_ai_search_stop (fc_ai_t *ai);
+
+/**
+ * @brief Waits for the background search to finish and returns its move.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[out] move If not NULL, set to the best move found.
+ *
+ * @return 1 if a move was found; 0 otherwise
+ */
+int fc_ai_search_wait (fc_ai_t *ai, fc_move_t *move);
+
+/**
+ * @brief Starts a search that is run a slice at a time.
+ *
+ * Nothing is searched until fc_ai_slice_run() is called.  The search keeps
+ * its place on the AI structure between slices, so a single thread can take
+ * turns searching for any number of games, one AI structure per game.  The
+ * search is always FC_NEGASCOUT, and gives the same ranked moves as
+ * fc_ai_next_ranked_moves() would with that algorithm.  The AI structure must
+ * not be used for any other search (nor its board changed) until
+ * fc_ai_slice_finish() is called.  If given is not NULL, it must be kept
+ * until then as well.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] given The moves to choose from, or NULL for all of the moves.
+ * @param[in] player The player we are finding the best move for.
+ * @param[in] depth Number of moves to look ahead; see fc_ai_next_move().
+ *
+ * @return 1 if the search was started; 0 otherwise
+ */
+int fc_ai_slice_start (fc_ai_t *ai, fc_mlist_t *given, fc_player_t player,
+		int depth);
+
+/**
+ * @brief Runs the search started by fc_ai_slice_start() for a while.
+ *
+ * Returns once about nodes more nodes have been searched (see
+ * fc_ai_get_nodes()) or the search is done, whichever comes first.  The next
+ * call picks up exactly where this one left off.  A node limit set with
+ * fc_ai_set_node_limit() applies to the search as a whole.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[in] nodes The number of nodes to search; 0 means until done.
+ *
+ * @return 1 if the search is done; 0 otherwise
+ */
+int fc_ai_slice_run (fc_ai_t *ai, unsigned long nodes);
+
+/**
+ * @brief Ends the search started by fc_ai_slice_start().
+ *
+ * If the search is done, its ranked moves are merged into moves and it
+ * becomes the principal variation.  A search that is not done is thrown
+ * away.  Either way, the AI structure is free for another search.
+ *
+ * @param[in,out] ai A pointer to the AI structure.
+ * @param[out] moves The ranked moves, best first; may be NULL.
+ *
+ * @return 1 if the search was done; 0 otherwise
+ */
+int fc_ai_slice_finish (fc_ai_t *ai, fc_mlist_t *moves);
+
 /**
  * FIXME
  * @brief Returns the best move as determined by the AI.
@@ -77,7 +560,7 @@ void fc_ai_set_algorithm (fc_ai_t *ai, fc_ai_algo_t algo);
  * @param[in] player The player we are finding the best move for.
  * @param[in] depth Number of moves to look ahead.  Each player's move
  * represents one "move".  So to look ahead one whole turn, you will need to
- * pass in 4.
+ * pass in 4.  For FC_MCTS this is the number of moves in each playout.
  * @param[in] seconds Approximate amount of time to spend looking for a move.
  * If seconds is 0, then no time limit is placed on the search; otherwise, the
  * search will return as quickly as possible after the number of seconds have
@@ -92,4 +575,48 @@ int fc_ai_next_ranked_moves (fc_ai_t *ai, fc_mlist_t *moves,
 		fc_mlist_t *given, fc_player_t player, int depth,
 		unsigned int seconds);
 
+/**
+ * @brief Returns the principal variation of the last search.
+ *
+ * The principal variation is the line of play that the AI expects to follow
+ * from the best move.  The first move of the line is the move returned by the
+ * last call to fc_ai_next_move() or fc_ai_next_ranked_moves(), and each
+ * subsequent move is the predicted reply of the next player still in the
+ * game (or, with FC_BRS, the best reply of either opponent).
+ *
+ * @param[in] ai A pointer to the AI structure.
+ * @param[out] line An array of at least max moves which will hold the line.
+ * @param[in] max The maximum number of moves to copy into line.
+ *
+ * @return The number of moves copied into line.
+ */
+int fc_ai_get_pv (fc_ai_t *ai, fc_move_t *line, int max);
+
+/**
+ * @brief Tries to prove that the player's team can force a win.
+ *
+ * Runs a proof-number search from the current board with player to move.  A
+ * win is a position in which fc_board_game_over() is true and both opposing
+ * kings have been captured.  A repeated position does not count as a win, and
+ * neither does any line longer than FC_SOLVE_MAX_PLIES moves.
+ *
+ * @param[in] ai A pointer to the AI structure.
+ * @param[in] player The player to move, whose team we are solving for.
+ * @param[in] node_limit The maximum number of nodes to expand; 0 means there
+ * is no limit.
+ * @param[in] memory The number of bytes to use for the table of proof and
+ * disproof numbers; 0 means the default of 16MB.  A budget of less than a few
+ * kilobytes is raised to the smallest table that can hold a search path.
+ * @param[out] move If not NULL and the win is proven, this is set to the first
+ * move of a winning line.
+ *
+ * @return FC_SOLVE_PROVEN if the team has a forced win; FC_SOLVE_DISPROVEN if
+ * there is no forced win within FC_SOLVE_MAX_PLIES; FC_SOLVE_UNKNOWN if the
+ * search ran out of nodes (or memory) before it could tell, or if it could
+ * only rule out a win by way of a repeated position, which holds for the line
+ * that repeated it but not for every way of reaching the position
+ */
+int fc_ai_solve (fc_ai_t *ai, fc_player_t player, unsigned long node_limit,
+		unsigned long memory, fc_move_t *move);
+
 #endif
@@ -52,9 +52,28 @@ typedef enum {
 	FC_TOTAL_BITBOARDS
 } fc_bitboards_t;
 
+/*
+ * Piece-square tables.  The tables are written once, from the first player's
+ * seat:  index 0 is a1, the corner behind him, 7 is h1 and 63 is h8.  They
+ * are turned to fit the other seats by fc_pst_rotate().  A pawn uses the table
+ * of its orientation, since that is the way it moves, and every other piece
+ * uses the table of the player who owns it.
+ */
+typedef struct {
+	int square[FC_NUM_PIECES][64];
+	int value[FC_NUM_PLAYERS][FC_NUM_PIECES][64]; /* filled in by rotating */
+} fc_pst_t;
+
 typedef struct {
 	uint64_t bitb[FC_TOTAL_BITBOARDS];
 	int piece_value[FC_NUM_PIECES];
+	/* the value of each player's pieces; kept up to date as the pieces
+	 * move, so that the position can be scored without counting them */
+	int material[FC_NUM_PLAYERS];
+	/* the piece-square tables (NULL for none) and each player's sum of
+	 * them, kept up to date in the same way */
+	const fc_pst_t *pst;
+	int positional[FC_NUM_PLAYERS];
 } fc_board_t;
 
 /* The following are used with the mlist_iter_t struct in the AI code.  I'm
@@ -68,11 +87,14 @@ typedef struct {
 	int partner_check_status;
 	int all_moves_are_invalid;
 	int initial_flag;
+	int allow_removes; /* fall back on the removes if no move is valid */
 } fc_board_state_t;
 void fc_board_state_init (fc_board_state_t *state, fc_board_t *board,
 		fc_player_t player);
 /* mlist_iter callback */
 fc_move_t *fc_board_get_next_move (fc_mlist_iter_t *iter);
+/* mlist_iter callback which skips the validity checks */
+fc_move_t *fc_board_get_next_pseudo_move (fc_mlist_iter_t *iter);
 
 /* macro to get the first 24 bitboards representing pieces */
 #define FC_BITBOARD(board, player, piece) (board->bitb[player * 6 + piece])
@@ -231,6 +253,60 @@ void fc_board_set_material_value (fc_board_t *board, fc_piece_t piece,
  */
 int fc_board_get_material_value (fc_board_t *board, fc_piece_t piece);
 
+/**
+ * @brief Fills in the built-in piece-square tables.
+ *
+ * The tables favor central squares for the minor pieces and the queen, keep
+ * the king near its corner, and reward pawns as they near promotion.
+ *
+ * @param[out] pst The tables to fill in.
+ *
+ * @return void
+ */
+void fc_pst_init (fc_pst_t *pst);
+
+/**
+ * @brief Reads piece-square tables from a file.
+ *
+ * The file holds a table for any of the pieces.  Each table is a line with
+ * the piece's character code (i.e. P, B, N, R, Q, K), followed by 64 numbers
+ * laid out as the board is seen from the first player's seat:  8 lines of 8,
+ * with rank 8 on top and the a-file on the left.  The pieces that have no
+ * table in the file get zeros.
+ *
+ * @param[out] pst The tables to fill in.
+ * @param[in] filename The name of the file.
+ *
+ * @return 1 on success; 0 otherwise
+ */
+int fc_pst_load (fc_pst_t *pst, const char *filename);
+
+/**
+ * @brief Turns the tables in pst->square to each of the four seats.
+ *
+ * fc_pst_init() and fc_pst_load() do this already; it is only needed after
+ * changing pst->square by hand.
+ *
+ * @param[in,out] pst The tables.
+ *
+ * @return void
+ */
+void fc_pst_rotate (fc_pst_t *pst);
+
+/**
+ * @brief Scores the board with piece-square tables as well as material.
+ *
+ * The board keeps a pointer to the tables, which must last as long as the
+ * board or any copy of it.  The tables count in fc_board_score_position() but
+ * not in fc_board_score_players(), whose scores are material only.
+ *
+ * @param[in,out] board A pointer to the board.
+ * @param[in] pst The tables, or NULL to score material only.
+ *
+ * @return void
+ */
+void fc_board_set_pst (fc_board_t *board, const fc_pst_t *pst);
+
 /**
  * @brief Adds a move to list.
  *
@@ -374,6 +450,18 @@ int fc_board_make_pawn_move (fc_board_t *board, fc_move_t *move,
  */
 void fc_board_copy (fc_board_t *dst, fc_board_t *src);
 
+/**
+ * @brief Returns a 64-bit key for the position of the pieces on the board.
+ *
+ * Boards with the same pieces on the same squares (and pawns facing the same
+ * directions) have the same key.  The key does not say whose turn it is.
+ *
+ * @param[in] board A pointer to the game board.
+ *
+ * @return The hash key of the board.
+ */
+uint64_t fc_board_hash (fc_board_t *board);
+
 #ifndef DOXYGEN_IGNORE
 #define FC_CHECK 1
 #define FC_CHECKMATE 2
@@ -394,6 +482,20 @@ void fc_board_copy (fc_board_t *dst, fc_board_t *src);
  */
 int fc_board_check_status (fc_board_t *board, fc_player_t player);
 
+/**
+ * @brief Tells whether the player's king is in check.
+ *
+ * Unlike fc_board_check_status(), this does not look for a way out of the
+ * check, which makes it cheap enough to call on every move of a search.
+ *
+ * @param[in] board A pointer to the game board.
+ * @param[in] player The player whose king is tested.
+ *
+ * @return 1 if the player's king is in check; 0 otherwise (including when
+ * the player has no king)
+ */
+int fc_board_in_check (fc_board_t *board, fc_player_t player);
+
 /**
  * @brief Determines whether or not a player has been eliminated from the
  * game.
@@ -420,8 +522,9 @@ int fc_board_game_over (fc_board_t *board);
  *
  * Returns the player's "score".  This number is determined by adding up
  * player's and player's partner's material score and subtracting their
- * opponent's material score.  This gives a basic idea of who is ahead (not
- * taking into account position) in the game.
+ * opponent's material score.  This gives a basic idea of who is ahead in the
+ * game.  If the board has piece-square tables (see fc_board_set_pst()), the
+ * position is counted the same way.
  *
  * @param[in] board A pointer to the game board.
  * @param[in] player The player we are returning the score for.
@@ -430,7 +533,67 @@ int fc_board_game_over (fc_board_t *board);
  */
 int fc_board_score_position (fc_board_t *board, fc_player_t player);
 
+/**
+ * @brief Static exchange evaluation of a move.
+ *
+ * Plays out the captures on the move's destination square, each made with the
+ * least valuable piece available, and returns the material that the mover's
+ * team comes out ahead (or behind if negative).  After each capture, the
+ * players of the other team may recapture in turn order:  first the next
+ * player, then the player across from him.  Either team may stop the exchange
+ * at any time.  No other moves are considered.
+ *
+ * @param[in] board A pointer to the game board.
+ * @param[in] move The move to evaluate; usually a capture.
+ *
+ * @return The material balance of the exchange for the mover's team.
+ */
+int fc_board_see (fc_board_t *board, fc_move_t *move);
+
+/**
+ * @brief Determine the material worth of the board for every player at once.
+ *
+ * Each player's score is twice the player's own material score plus the
+ * material score of the player's partner, so no score is ever negative and
+ * the scores always add up to three times the material on the board.
+ *
+ * @param[in] board A pointer to the game board.
+ * @param[out] scores An array of FC_NUM_PLAYERS scores indexed by player.
+ *
+ * @return void
+ */
+void fc_board_score_players (fc_board_t *board, int *scores);
+
 /* TODO */
 int fc_board_num_players (fc_board_t *board);
 
+/**
+ * @brief Picks the fastest way to count and scan bits on this processor.
+ *
+ * fc_board_init() calls this, so it is only needed if fc_popcount() or
+ * fc_bitscan() is used before any board has been initialized.  Until then,
+ * the portable versions are used.  It is safe to call from several threads.
+ *
+ * @return void
+ */
+void fc_bits_init (void);
+
+/**
+ * @brief Counts the bits that are set in a bitboard.
+ *
+ * @param[in] bb A bitboard.
+ *
+ * @return The number of pieces (bits) on the bitboard.
+ */
+int fc_popcount (uint64_t bb);
+
+/**
+ * @brief Finds the square of the lowest bit that is set in a bitboard.
+ *
+ * @param[in] bb A bitboard with at least one bit set.
+ *
+ * @return The index of the bit, from 0 (a1) to 63 (h8).
+ */
+int fc_bitscan (uint64_t bb);
+
 #endif
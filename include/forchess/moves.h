@@ -104,6 +104,18 @@ void fc_move_copy (fc_move_t *dst, fc_move_t *src);
  */
 void fc_move_set_promotion (fc_move_t *move, fc_piece_t promote);
 
+/**
+ * @brief Returns 1 if the position before move could come up again.
+ *
+ * Captures, removes and pawn moves can never be undone, so no position from
+ * before one of them can be repeated after it.
+ *
+ * @param[in] move The move.
+ *
+ * @return 1 if the move is reversible; 0 otherwise
+ */
+int fc_move_is_reversible (fc_move_t *move);
+
 /**
  * @brief Initialize an mlist.
  *
@@ -146,6 +158,23 @@ int fc_mlist_copy (fc_mlist_t *dst, fc_mlist_t *src);
  */
 int fc_mlist_insert (fc_mlist_t *list, fc_move_t *move, int32_t value);
 
+/**
+ * @brief Inserts move into list based on value, but no earlier than index.
+ *
+ * Only the moves from index onward are kept in the order described in
+ * fc_mlist_insert().  This lets a caller that is walking the list add moves
+ * without disturbing the moves it has already visited.
+ *
+ * @param list The move list.
+ * @param index The first position at which the move may be placed.
+ * @param move The move to be inserted.
+ * @param value The "value" of the move.
+ *
+ * @return 1 on successful insertion; 0 otherwise
+ */
+int fc_mlist_insert_from (fc_mlist_t *list, int index, fc_move_t *move,
+		int32_t value);
+
 /**
  * @brief Merges two lists together.
  *
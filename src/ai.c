@@ -19,22 +19,142 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+/* needed for clock_gettime() under -std=c89 */
+#define _POSIX_C_SOURCE 200112L
+
 #include <assert.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "forchess/ai.h"
 #include "forchess/board.h"
 #include "forchess/moves.h"
 
+/*
+ * The time manager.  See allot_time() and iterative_deepening() below.
+ */
+#define MOVES_PER_PLAYER 10
+#define RESERVE_RATIO 20
+#define RESERVE_MSECS 50
+#define HARD_RATIO 4
+#define UNSTABLE_RATIO 2
+#define STABLE_ITERATIONS 3
+
+/* how often a search in a background thread checks whether to stop */
+#define STOP_CHECK_MASK 1023
+
+/* the size of the transposition table if none is given */
+#define DEFAULT_HASH_MEMORY (2 * 1024 * 1024)
+
+/* a salt for the player to move; see also FC_LEFT_COL */
+#define PLAYER_SALT ((((uint64_t)0x9E3779B9) << 32) | ((uint64_t)0x7F4A7C15))
+
+/* a salt for the root player in beam mode (see table_key()) */
+#define ROOT_SALT ((((uint64_t)0xC2B2AE3D) << 32) | ((uint64_t)0x27D4EB4F))
+
+/* how a stored value bounds the value of the position */
+#define HASH_EXACT 0
+#define HASH_LOWER 1
+#define HASH_UPPER 2
+
+/* the score of a position that has come up before */
+#define DRAW_SCORE 0
+
+/* the history scores are halved once one of them reaches the limit */
+#define HISTORY_LIMIT (1 << 20)
+
+struct fc_ai_entry_ {
+	uint64_t key; /* 0 if the entry is empty */
+	uint64_t move; /* the best move; 0 if none is known */
+	int32_t value;
+	uint8_t depth;
+	uint8_t bound;
+	uint8_t age;
+	int8_t piece;
+	int8_t promote;
+};
+
 void fc_ai_init (fc_ai_t *ai, fc_board_t *board)
 {
 	assert(ai && board);
 	ai->board = board;
 	ai->bv = NULL;
 	ai->mlv = NULL;
+	ai->pvt = NULL;
+	ai->pvl = NULL;
+	ai->pv_length = 0;
 	ai->algo = FC_NEGASCOUT;
+	ai->playouts = 0;
+	ai->msecs = 0;
+	ai->threads = 1;
+	ai->node_limit = 0;
+	ai->nodes = 0;
+	ai->clock = 0;
+	ai->increment = 0;
+	ai->moves_to_go = 0;
+	ai->deadline = 0;
+	ai->forced = 0;
+	ai->forced_moves = 1;
+	ai->thread = NULL;
+	ai->ponder = NULL;
+	ai->search = NULL;
+	ai->slice = NULL;
+	ai->progress = NULL;
+	ai->progress_data = NULL;
+	ai->stack_depth = 0;
+	ai->hash = NULL;
+	ai->hash_size = 0;
+	ai->hash_memory = DEFAULT_HASH_MEMORY;
+	ai->age = 0;
+	memset(ai->killers, 0, sizeof(ai->killers));
+	memset(ai->history, 0, sizeof(ai->history));
+	ai->keys = NULL;
+	ai->reversible = NULL;
+	ai->keys_size = 0;
+	ai->played = 0;
+	ai->pseudo_legal = 0;
+	ai->futility = 1;
+	ai->beam_opponent = 0;
+	ai->beam_partner = 0;
+	ai->player = FC_FIRST;
+	memset(ai->guess, 0, sizeof(ai->guess));
+}
+
+void fc_ai_set_hash_size (fc_ai_t *ai, unsigned long bytes)
+{
+	assert(ai);
+	free(ai->hash);
+	ai->hash = NULL;
+	ai->hash_size = 0;
+	ai->hash_memory = (bytes) ? bytes : DEFAULT_HASH_MEMORY;
+}
+
+void fc_ai_set_pseudo_legal (fc_ai_t *ai, int on)
+{
+	assert(ai);
+	ai->pseudo_legal = on;
+}
+
+void fc_ai_set_futility (fc_ai_t *ai, int on)
+{
+	assert(ai);
+	ai->futility = on;
+}
+
+void fc_ai_set_beam (fc_ai_t *ai, int opponent, int partner)
+{
+	assert(ai && opponent >= 0 && partner >= 0);
+	if (opponent == ai->beam_opponent && partner == ai->beam_partner) {
+		return;
+	}
+	/* the stored scores were searched with the old widths */
+	free(ai->hash);
+	ai->hash = NULL;
+	ai->hash_size = 0;
+	ai->beam_opponent = opponent;
+	ai->beam_partner = partner;
 }
 
 void fc_ai_set_algorithm (fc_ai_t *ai, fc_ai_algo_t algo)
@@ -43,13 +163,91 @@ void fc_ai_set_algorithm (fc_ai_t *ai, fc_ai_algo_t algo)
 	ai->algo = algo;
 }
 
-static int time_up (fc_ai_t *ai)
+void fc_ai_set_mcts_budget (fc_ai_t *ai, unsigned long playouts,
+		unsigned long msecs)
 {
-	if (ai->timeout == 0) {
-		return 0;
+	assert(ai);
+	ai->playouts = playouts;
+	ai->msecs = msecs;
+}
+
+void fc_ai_set_threads (fc_ai_t *ai, int threads)
+{
+	assert(ai);
+	ai->threads = threads;
+}
+
+void fc_ai_set_node_limit (fc_ai_t *ai, unsigned long nodes)
+{
+	assert(ai);
+	ai->node_limit = nodes;
+}
+
+unsigned long fc_ai_get_nodes (fc_ai_t *ai)
+{
+	assert(ai);
+	return ai->nodes;
+}
+
+void fc_ai_set_progress (fc_ai_t *ai, fc_ai_progress_t progress, void *data)
+{
+	assert(ai);
+	ai->progress = progress;
+	ai->progress_data = data;
+}
+
+int fc_ai_was_forced (fc_ai_t *ai)
+{
+	assert(ai);
+	return ai->forced;
+}
+
+void fc_ai_set_forced_moves (fc_ai_t *ai, int on)
+{
+	assert(ai);
+	ai->forced_moves = on;
+}
+
+void fc_ai_set_clock (fc_ai_t *ai, unsigned long msecs,
+		unsigned long increment, int moves_to_go)
+{
+	assert(ai);
+	ai->clock = msecs;
+	ai->increment = increment;
+	ai->moves_to_go = moves_to_go;
+}
+
+static long now_in_ms (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/*
+ * Called on entry to every node of the search, which is counted here.  Returns
+ * 1 (and marks the search as stopped) once the node limit has been reached or
+ * the time has run out.  Nodes past the limit are not counted, so that the
+ * count (and the result of the search) does not depend on the speed of the
+ * machine.
+ */
+static int budget_spent (fc_ai_t *ai)
+{
+	if (ai->node_limit && ai->nodes >= ai->node_limit) {
+		ai->stopped = 1;
+		return 1;
 	}
+	ai->nodes += 1;
 
-	return time(NULL) >= ai->timeout;
+	if ((ai->timeout && time(NULL) >= ai->timeout) ||
+			(ai->deadline && now_in_ms() >= ai->deadline) ||
+			(ai->thread && (ai->nodes & STOP_CHECK_MASK) == 0 &&
+			 fc_ai_thread_stopping(ai->thread))) {
+		ai->stopped = 1;
+		return 1;
+	}
+	return 0;
 }
 
 /*
@@ -78,6 +276,92 @@ static void create_mlist_iterator (fc_mlist_iter_t *iter, fc_mlist_t *given,
 	}
 }
 
+/*
+ * Pseudo-legal mode (see fc_ai_set_pseudo_legal()):  a player who is not in
+ * check gets his moves without the validity checks, and the invalid ones are
+ * thrown out by is_legal() once they have been made.  Sets up the iterator
+ * over the moves already in list.
+ */
+static void init_pseudo_iterator (fc_mlist_iter_t *iter,
+		fc_board_state_t *state, fc_mlist_t *list, fc_board_t *board,
+		fc_player_t player)
+{
+	state->board = board;
+	state->player = player;
+	state->current_check_status = 0;
+	state->partner_check_status = fc_board_in_check(board,
+			FC_PARTNER(player));
+	state->all_moves_are_invalid = 1;
+	state->initial_flag = 1;
+	state->allow_removes = 1;
+	fc_mlist_iter_init(list, iter, fc_board_get_next_pseudo_move);
+	fc_mlist_iter_set_state(iter, state);
+}
+
+/*
+ * The checks of fc_board_is_move_valid() for a player who was not in check,
+ * made on the board after the move:  the move must not leave his king in
+ * check, nor put his partner's king in check.
+ */
+static int is_legal (fc_board_state_t *state, fc_board_t *copy)
+{
+	return (!fc_board_in_check(copy, state->player) &&
+		(state->partner_check_status ||
+		 !fc_board_in_check(copy, FC_PARTNER(state->player))));
+}
+
+static int same_move (fc_move_t *a, fc_move_t *b)
+{
+	return (a->move == b->move && a->player == b->player &&
+		a->piece == b->piece && a->promote == b->promote);
+}
+
+/*
+ * If we are still following the principal variation of the last search, then
+ * move its move for this ply to the front of the list so that it is searched
+ * first.  Once we step off of the old line, we stop looking for it.
+ */
+static void order_pv_move (fc_ai_t *ai, fc_mlist_t *list, int depth)
+{
+	int i, ply;
+	fc_move_t pv;
+
+	ply = ai->depth - depth;
+	if (!ai->follow_pv || ply >= ai->pv_length) {
+		ai->follow_pv = 0;
+		return;
+	}
+
+	for (i = 0; i < fc_mlist_length(list); i++) {
+		if (same_move(fc_mlist_get(list, i), &(ai->pv[ply]))) {
+			fc_move_copy(&pv, fc_mlist_get(list, i));
+			fc_mlist_delete(list, i);
+			fc_mlist_insert(list, &pv, INT32_MAX);
+			return;
+		}
+	}
+	ai->follow_pv = 0;
+}
+
+/*
+ * The principal variation table is triangular:  the row for a given depth
+ * holds the best line found from that node, which is the best move followed
+ * by the line of the child node one depth below it.
+ */
+static void update_pv (fc_ai_t *ai, int depth, fc_move_t *move)
+{
+	int i;
+	fc_move_t *line, *child;
+
+	line = ai->pvt + depth * ai->depth;
+	child = ai->pvt + (depth - 1) * ai->depth;
+	fc_move_copy(line, move);
+	for (i = 0; i < ai->pvl[depth - 1]; i++) {
+		fc_move_copy(line + i + 1, child + i);
+	}
+	ai->pvl[depth] = ai->pvl[depth - 1] + 1;
+}
+
 static void append_remaining_moves_onto_list (fc_mlist_t *list,
 		fc_mlist_iter_t *iter)
 {
@@ -92,6 +376,206 @@ static void append_remaining_moves_onto_list (fc_mlist_t *list,
 	}
 }
 
+/*
+ * Returns the score of the board from the player's point of view.  Once a
+ * team has been eliminated, the score is a win or a loss with the number of
+ * plies it took to get there taken off, so that the quickest win (or the
+ * slowest loss) is preferred.
+ */
+static int score_position (fc_ai_t *ai, fc_board_t *board, fc_player_t player,
+		int depth)
+{
+	int ply;
+
+	ply = ai->depth - depth;
+	if (fc_board_game_over(board)) {
+		if (fc_board_is_player_out(board, player) &&
+				fc_board_is_player_out(board, FC_PARTNER(player))) {
+			return ply - FC_AI_WIN_SCORE;
+		}
+		return FC_AI_WIN_SCORE - ply;
+	}
+	return fc_board_score_position(board, player);
+}
+
+/*
+ * Capturing a king that does not end the game is worth the number of plies
+ * that remain in the search on top of its material, so that the AI prefers
+ * the earlier of two otherwise equal king captures.
+ */
+static int king_capture_bonus (fc_board_t *board, fc_move_t *move, int depth)
+{
+	if (move->opp_piece != FC_KING || fc_board_game_over(board)) {
+		return 0;
+	}
+	return depth;
+}
+
+/*
+ * Wins and losses are scored by their distance alone, so the king capture
+ * bonus is only added to the scores in between.  A child is searched with
+ * its window shifted the same way:  remove_bonus() takes the bonus back off
+ * a bound that is not a win or a loss.
+ */
+static int is_mate_score (int value)
+{
+	return value > FC_AI_WIN_SCORE / 2 || value < -FC_AI_WIN_SCORE / 2;
+}
+
+static int add_bonus (int bonus, int value)
+{
+	return (is_mate_score(value)) ? value : value + bonus;
+}
+
+static int remove_bonus (int bonus, int bound)
+{
+	return (is_mate_score(bound)) ? bound : bound - bonus;
+}
+
+/*
+ * Mate-distance pruning:  a node at the given depth can do no better than
+ * winning on the very next ply, nor any worse than losing on it.  Narrows the
+ * window to those bounds and returns 1 if there is nothing left to search.
+ */
+static int mate_distance_cutoff (fc_ai_t *ai, int depth, int *alpha,
+		int *beta)
+{
+	int bound;
+
+	bound = FC_AI_WIN_SCORE - (ai->depth - depth) - 1;
+	if (*alpha < -bound) {
+		*alpha = -bound;
+	}
+	if (*beta > bound) {
+		*beta = bound;
+	}
+	return *alpha >= *beta;
+}
+
+/*
+ * The keys of the played positions are followed by those of the positions
+ * along the current line of the search, one per ply.  reversible[i] is the
+ * number of positions before the i'th which may be the same position.
+ */
+static int reserve_keys (fc_ai_t *ai, int size)
+{
+	uint64_t *keys;
+	int *reversible;
+
+	if (size <= ai->keys_size) {
+		return 1;
+	}
+	keys = realloc(ai->keys, size * sizeof(uint64_t));
+	if (!keys) {
+		return 0;
+	}
+	ai->keys = keys;
+	reversible = realloc(ai->reversible, size * sizeof(int));
+	if (!reversible) {
+		return 0;
+	}
+	ai->reversible = reversible;
+	ai->keys_size = size;
+	return 1;
+}
+
+void fc_ai_set_played_positions (fc_ai_t *ai, const uint64_t *keys,
+		int count)
+{
+	int i;
+
+	assert(ai && (keys || count == 0));
+	if (!reserve_keys(ai, count + 1)) {
+		count = 0;
+	}
+	for (i = 0; i < count; i++) {
+		ai->keys[i] = keys[i];
+		ai->reversible[i] = i;
+	}
+	ai->played = count;
+}
+
+/*
+ * Called after the move from the node at depth has been made, for the node
+ * one ply down.
+ */
+static void note_move (fc_ai_t *ai, int depth, fc_move_t *move)
+{
+	int i;
+
+	i = ai->played + ai->depth - depth + 1;
+	ai->reversible[i] = (fc_move_is_reversible(move)) ?
+		ai->reversible[i - 1] + 1 : 0;
+}
+
+/*
+ * Puts the key of the node at depth on the line and returns 1 if the same
+ * position (with the same player to move) came up earlier on the line or in
+ * the game.  A player needs at least two plies to get back to a position.
+ */
+static int is_repetition (fc_ai_t *ai, int depth, uint64_t key)
+{
+	int i, j;
+
+	i = ai->played + ai->depth - depth;
+	ai->keys[i] = key;
+	for (j = 2; j <= ai->reversible[i]; j++) {
+		if (ai->keys[i - j] == key) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int same_team (fc_player_t a, fc_player_t b)
+{
+	return a == b || a == FC_PARTNER(b);
+}
+
+/*
+ * Fills in the seat table for a search from board.  With three players left,
+ * one of them is followed by his partner, and with two left, the players
+ * alternate with each other; either way the empty seats are never visited.
+ */
+static void set_seats (fc_ai_t *ai, fc_board_t *board)
+{
+	int i;
+	fc_player_t p, next;
+
+	for (p = FC_FIRST; p <= FC_FOURTH; p++) {
+		next = p;
+		for (i = 0; i < FC_NUM_PLAYERS; i++) {
+			next = FC_NEXT_PLAYER(next);
+			if (!fc_board_is_player_out(board, next)) {
+				break;
+			}
+		}
+		ai->seat[p] = next;
+	}
+}
+
+/*
+ * Returns the player who moves after player on board, which is a position
+ * below the root.  The seats that were empty at the root are skipped by the
+ * table, so only a player who has been knocked out since then costs a look
+ * at the board.
+ */
+static fc_player_t next_seat (fc_ai_t *ai, fc_board_t *board,
+		fc_player_t player)
+{
+	int i;
+	fc_player_t next;
+
+	next = ai->seat[player];
+	for (i = 0; i < FC_NUM_PLAYERS; i++) {
+		if (!fc_board_is_player_out(board, next)) {
+			break;
+		}
+		next = ai->seat[next];
+	}
+	return next;
+}
+
 /*
  * Adjusts the alpha and beta values given the score.  If ret is not NULL, it
  * copies the move to ret.  Returns 1 if the given score was a cutoff for the
@@ -121,14 +605,15 @@ static int alphabeta_cutoff (int score, int *alpha, int *beta, int max)
 static int alphabeta (fc_ai_t *ai, fc_mlist_t *ret, fc_mlist_t *given,
 		fc_player_t player, int depth, int alpha, int beta, int max)
 {
-	int score;
+	int bonus, score;
 	fc_board_t *board, *copy;
 	fc_board_state_t state;
 	fc_move_t *move;
 	fc_mlist_t *list;
 	fc_mlist_iter_t iter;
+	fc_player_t next;
 
-	if (time_up(ai)) {
+	if (budget_spent(ai)) {
 		/*
 		 * Return a value that will fail the conditions in
 		 * alphabeta_cutoff(), i.e. don't take this move into
@@ -137,35 +622,51 @@ static int alphabeta (fc_ai_t *ai, fc_mlist_t *ret, fc_mlist_t *given,
 		return (max) ? beta : alpha;
 	}
 	board = &(ai->bv[depth]);
+	ai->pvl[depth] = 0;
 	if (fc_board_game_over(board) || depth == 0) {
-		score = fc_board_score_position(board, player);
-		/*
-		 * Adjusting the scores with the current depth expedites the
-		 * end of the game.  Otherwise the AI will just move from one
-		 * position to the next without making the killing blow.
-		 */
-		return (max) ? score - depth : depth - score;
+		score = score_position(ai, board, player, depth);
+		return (max) ? score : -score;
 	}
 	if (fc_board_is_player_out(board, player)) {
 		return alphabeta(ai, NULL, NULL, FC_NEXT_PLAYER(player), depth,
 				alpha, beta, !max);
 	}
+	if (is_repetition(ai, depth, fc_ai_node_key(board, player)) && !ret) {
+		return (max) ? DRAW_SCORE : -DRAW_SCORE;
+	}
+	if (mate_distance_cutoff(ai, depth, &alpha, &beta)) {
+		return (max) ? alpha : beta;
+	}
 
 	copy = &(ai->bv[depth - 1]);
 	list = &(ai->mlv[depth - 1]);
 	create_mlist_iterator(&iter, given, &state, list, board, player);
+	if (!given) {
+		order_pv_move(ai, list, depth);
+	}
 	while (fc_mlist_iter_next(&iter)) {
 		fc_board_copy(copy, board);
 		move = fc_mlist_iter_get_move(&iter);
 		fc_board_make_move(copy, move);
+		note_move(ai, depth, move);
 
-		score = alphabeta(ai, NULL, NULL, FC_NEXT_PLAYER(player),
-				depth - 1, alpha, beta, !max);
+		bonus = king_capture_bonus(copy, move, depth);
+		bonus = (max) ? bonus : -bonus;
+		next = next_seat(ai, copy, player);
+		score = add_bonus(bonus, alphabeta(ai, NULL, NULL, next,
+					depth - 1, remove_bonus(bonus, alpha),
+					remove_bonus(bonus, beta),
+					(same_team(next, player)) ? max : !max));
+		ai->follow_pv = 0;
 
 		if (ret) {
 			fc_mlist_insert(ret, move, score);
 		}
 
+		if ((max && score > alpha) || (!max && score < beta)) {
+			update_pv(ai, depth, move);
+		}
+
 		if (alphabeta_cutoff(score, &alpha, &beta, max)) {
 			break;
 		}
@@ -187,61 +688,1118 @@ static int negascout_cutoff (int score, int *alpha, int *beta)
 	return alphabeta_cutoff(score, alpha, beta, 1);
 }
 
-static int negascout (fc_ai_t *ai, fc_mlist_t *ret, fc_mlist_t *given,
-		fc_player_t player, int depth, int alpha, int beta)
+/*
+ * The margins for futility pruning and razoring are given in terms of the
+ * board's material values, so that they are tuned along with the evaluation
+ * by fc_board_set_material_value().  A quiet move should never gain more than
+ * a pawn's worth at a frontier node, and the captures of a pre-frontier node
+ * are expected to make up for anything less than a rook.
+ */
+#define FUTILITY_MARGIN(board) fc_board_get_material_value(board, FC_PAWN)
+#define RAZOR_MARGIN(board) fc_board_get_material_value(board, FC_ROOK)
+
+/*
+ * A quiet move neither captures nor promotes a piece.
+ */
+static int is_quiet_move (fc_board_t *board, fc_move_t *move)
+{
+	fc_player_t side;
+
+	return (move->opp_piece == FC_NONE && move->promote == FC_NONE &&
+		!fc_board_move_requires_promotion(board, move, &side));
+}
+
+/*
+ * Deletes the quiet moves from the list starting at index.  Working backwards
+ * keeps the deletes cheap since the quiet moves are sorted to the end.
+ */
+static void drop_quiet_moves (fc_board_t *board, fc_mlist_t *list, int index)
+{
+	int i;
+
+	for (i = fc_mlist_length(list) - 1; i >= index; i--) {
+		if (is_quiet_move(board, fc_mlist_get(list, i))) {
+			fc_mlist_delete(list, i);
+		}
+	}
+}
+
+/*
+ * Deletes the captures which lose material according to their static exchange
+ * evaluation.  A capture of a piece worth at least as much as the capturing
+ * piece can never lose material, so it is kept without the cost of an
+ * exchange evaluation.
+ */
+static void drop_losing_captures (fc_board_t *board, fc_mlist_t *list)
+{
+	int i;
+	fc_move_t *move;
+
+	for (i = fc_mlist_length(list) - 1; i >= 0; i--) {
+		move = fc_mlist_get(list, i);
+		if (move->opp_piece == FC_NONE ||
+		    fc_board_get_material_value(board, move->opp_piece) >=
+		    fc_board_get_material_value(board, move->piece)) {
+			continue;
+		}
+		if (fc_board_see(board, move) < 0) {
+			fc_mlist_delete(list, i);
+		}
+	}
+}
+
+/*
+ * mlist_iter callback used at frontier nodes that are too far below alpha for
+ * a quiet move to matter.  Once a valid move has been found, and we know the
+ * player will not be reduced to removing a piece, the quiet moves which
+ * remain are dropped without ever being checked for validity.
+ */
+static fc_move_t *get_next_futile_move (fc_mlist_iter_t *iter)
+{
+	fc_board_state_t *state;
+
+	state = fc_mlist_iter_get_state(iter);
+	if (!state->initial_flag && !state->all_moves_are_invalid) {
+		drop_quiet_moves(state->board, fc_mlist_iter_get_mlist(iter),
+				fc_mlist_iter_get_index(iter));
+	}
+	return fc_board_get_next_move(iter);
+}
+
+/*
+ * A capture-only search that razoring drops into.  The player may always
+ * "stand pat" on the static score rather than make a capture, so the score of
+ * the position is never less than the static score.  It searches the given
+ * number of plies from the board at depth.
+ */
+static int quiesce (fc_ai_t *ai, fc_player_t player, int depth, int plies,
+		int alpha, int beta)
 {
-	int b, first, score;
+	int best, bonus, score;
 	fc_board_t *board, *copy;
 	fc_board_state_t state;
 	fc_move_t *move;
 	fc_mlist_t *list;
 	fc_mlist_iter_t iter;
+	fc_player_t next;
+	int pseudo;
 
-	if (time_up(ai)) {
+	if (budget_spent(ai)) {
 		return beta;
 	}
 	board = &(ai->bv[depth]);
-	if (fc_board_game_over(board) || depth == 0) {
-		score = fc_board_score_position(board, player);
+	score = score_position(ai, board, player, depth);
+	if (fc_board_game_over(board) || plies == 0) {
 		return score;
 	}
 	if (fc_board_is_player_out(board, player)) {
-		return -negascout(ai, NULL, NULL, FC_NEXT_PLAYER(player),
-				depth, -beta, -alpha);
+		return -quiesce(ai, FC_NEXT_PLAYER(player), depth, plies,
+				-beta, -alpha);
+	}
+	best = score;
+	if (negascout_cutoff(score, &alpha, &beta)) {
+		return best;
 	}
 
 	copy = &(ai->bv[depth - 1]);
 	list = &(ai->mlv[depth - 1]);
-	create_mlist_iterator(&iter, given, &state, list, board, player);
-	for (first = 1, b = beta; fc_mlist_iter_next(&iter); b = alpha + 1) {
+	fc_mlist_clear(list);
+	fc_board_get_all_moves(board, list, player);
+	drop_quiet_moves(board, list, 0);
+	drop_losing_captures(board, list);
+	pseudo = (ai->pseudo_legal && !fc_board_in_check(board, player));
+	if (pseudo) {
+		init_pseudo_iterator(&iter, &state, list, board, player);
+	} else {
+		fc_board_state_init(&state, board, player);
+		fc_mlist_iter_init(list, &iter, fc_board_get_next_move);
+		fc_mlist_iter_set_state(&iter, &state);
+	}
+	state.allow_removes = 0;
+	while (fc_mlist_iter_next(&iter)) {
 		fc_board_copy(copy, board);
 		move = fc_mlist_iter_get_move(&iter);
 		fc_board_make_move(copy, move);
-
-		score = -negascout(ai, NULL, NULL, FC_NEXT_PLAYER(player),
-				depth - 1, -b, -alpha);
-
-		if (!first && alpha < score && score < beta) {
-			score = -negascout(ai, NULL, NULL,
-					FC_NEXT_PLAYER(player), depth - 1,
-					-beta, -alpha);
+		if (pseudo && !is_legal(&state, copy)) {
+			continue;
 		}
-		first = 0;
 
-		if (ret) {
-			fc_mlist_insert(ret, move, score);
+		bonus = king_capture_bonus(copy, move, plies);
+		next = next_seat(ai, copy, player);
+		if (same_team(next, player)) {
+			score = add_bonus(bonus, quiesce(ai, next, depth - 1,
+					plies - 1, remove_bonus(bonus, alpha),
+					remove_bonus(bonus, beta)));
+		} else {
+			score = add_bonus(bonus, -quiesce(ai, next, depth - 1,
+					plies - 1, -remove_bonus(bonus, beta),
+					-remove_bonus(bonus, alpha)));
+		}
+		if (score > best) {
+			best = score;
 		}
-
 		if (negascout_cutoff(score, &alpha, &beta)) {
 			break;
 		}
 	}
 
-	if (ret) {
+	return best;
+}
+
+/*
+ * The same position with a different player to move is a different node.
+ * The key 0 marks an empty slot, so it is never returned.
+ */
+uint64_t fc_ai_node_key (fc_board_t *board, fc_player_t player)
+{
+	uint64_t key;
+
+	key = fc_board_hash(board) ^ (PLAYER_SALT * (player + 1));
+	return (key) ? key : 1;
+}
+
+/*
+ * The history score of a quiet move:  how often the piece moving to that
+ * square has caused a cutoff, weighted by the depth of the cutoff.  Returns
+ * NULL for a move without a destination (a remove).
+ */
+static int32_t *history_of (fc_ai_t *ai, fc_board_t *board, fc_move_t *move)
+{
+	uint64_t to;
+
+	to = move->move & ~FC_BITBOARD(board, move->player, move->piece);
+	if (!to) {
+		return NULL;
+	}
+	return &(ai->history[move->player][move->piece][fc_bitscan(to)]);
+}
+
+static void age_history (fc_ai_t *ai)
+{
+	int i, j, k;
+
+	for (i = 0; i < FC_NUM_PLAYERS; i++) {
+		for (j = 0; j < FC_NUM_PIECES; j++) {
+			for (k = 0; k < 64; k++) {
+				ai->history[i][j][k] /= 2;
+			}
+		}
+	}
+}
+
+static int is_quiet (fc_move_t *move)
+{
+	return move->opp_piece == FC_NONE && move->promote == FC_NONE;
+}
+
+/*
+ * Remembers a quiet move that caused a cutoff:  as the first killer move of
+ * its ply, and in the history of its piece and square, weighted by the depth
+ * that was left to search.
+ */
+static void record_cutoff (fc_ai_t *ai, fc_move_t *move, int depth,
+		int remaining)
+{
+	int ply;
+	int32_t *history;
+	fc_move_t *killers;
+
+	if (!is_quiet(move)) {
+		return;
+	}
+	ply = ai->depth - depth;
+	if (ply < FC_AI_MAX_PV) {
+		killers = ai->killers[ply];
+		if (!same_move(killers, move)) {
+			fc_move_copy(killers + 1, killers);
+			fc_move_copy(killers, move);
+		}
+	}
+	history = history_of(ai, &(ai->bv[depth]), move);
+	if (history) {
+		*history += remaining * remaining;
+		if (*history >= HISTORY_LIMIT) {
+			age_history(ai);
+		}
+	}
+}
+
+/*
+ * The quiet moves come last in the list, all with a value of 0.  They are
+ * given new values below those of the captures and sorted:  the killer moves
+ * of the ply first, and then the rest by their history scores.
+ */
+static void order_quiet_moves (fc_ai_t *ai, fc_mlist_t *list, int depth)
+{
+	int i, j, n, first, ply;
+	int32_t *history;
+	fc_move_t move;
+	fc_move_t *killers;
+
+	n = fc_mlist_length(list);
+	for (first = n; first > 0 &&
+			fc_mlist_get(list, first - 1)->value == 0; first--)
+		;
+	ply = ai->depth - depth;
+	killers = (ply < FC_AI_MAX_PV) ? ai->killers[ply] : NULL;
+	for (i = first; i < n; i++) {
+		fc_move_copy(&move, fc_mlist_get(list, i));
+		if (killers && same_move(&move, killers)) {
+			move.value = 0;
+		} else if (killers && same_move(&move, killers + 1)) {
+			move.value = -1;
+		} else {
+			history = history_of(ai, &(ai->bv[depth]), &move);
+			move.value = ((history) ? *history : 0) -
+				HISTORY_LIMIT - 2;
+		}
+		for (j = i; j > first &&
+				fc_mlist_get(list, j - 1)->value < move.value;
+				j--) {
+			fc_move_copy(fc_mlist_get(list, j),
+					fc_mlist_get(list, j - 1));
+		}
+		fc_move_copy(fc_mlist_get(list, j), &move);
+	}
+}
+
+/*
+ * Wins and losses are stored as the distance from the node rather than from
+ * the root, since the same node may come up at any ply.
+ */
+static int32_t value_to_hash (int value, int ply)
+{
+	if (value > FC_AI_WIN_SCORE / 2) {
+		return value + ply;
+	} else if (value < -FC_AI_WIN_SCORE / 2) {
+		return value - ply;
+	}
+	return value;
+}
+
+static int value_from_hash (int32_t value, int ply)
+{
+	if (value > FC_AI_WIN_SCORE / 2) {
+		return value - ply;
+	} else if (value < -FC_AI_WIN_SCORE / 2) {
+		return value + ply;
+	}
+	return value;
+}
+
+/*
+ * The key of a node in the transposition table.  The beam narrows different
+ * plies for each root player, so in beam mode the values stored under one
+ * root player are kept apart from those of another.
+ */
+static uint64_t table_key (fc_ai_t *ai, uint64_t key)
+{
+	if (ai->beam_opponent || ai->beam_partner) {
+		key ^= ROOT_SALT * (ai->player + 1);
+	}
+	return (key) ? key : 1;
+}
+
+/*
+ * A position may be kept in either entry of its pair.  If it is in neither,
+ * the entry to replace is one left by the search of an earlier move, or else
+ * the shallower of the two.  The deep results of one move thus carry over to
+ * the next until newer results push them out.
+ */
+static fc_ai_entry_t *hash_entry (fc_ai_t *ai, uint64_t key, int store)
+{
+	fc_ai_entry_t *e;
+
+	e = ai->hash + (key & (ai->hash_size - 2));
+	if (e[0].key == key) {
+		return e;
+	} else if (e[1].key == key) {
+		return e + 1;
+	} else if (!store) {
+		return NULL;
+	} else if (e[0].age != ai->age) {
+		return e;
+	} else if (e[1].age != ai->age) {
+		return e + 1;
+	}
+	return (e[0].depth <= e[1].depth) ? e : e + 1;
+}
+
+/*
+ * Moves the best move that was stored for the position to the front of the
+ * list, right behind the move of the principal variation.
+ */
+static void order_hash_move (fc_mlist_t *list, fc_ai_entry_t *e)
+{
+	int i;
+	fc_move_t move, *m;
+
+	for (i = 0; i < fc_mlist_length(list); i++) {
+		m = fc_mlist_get(list, i);
+		if (m->move == e->move && m->piece == e->piece &&
+				m->promote == e->promote) {
+			fc_move_copy(&move, m);
+			fc_mlist_delete(list, i);
+			fc_mlist_insert(list, &move, INT32_MAX - 1);
+			return;
+		}
+	}
+}
+
+/*
+ * Called at the start of the search for each move (but not for each search
+ * of iterative deepening).  Ages the transposition table and the history
+ * scores, and allocates the table if it has not been.
+ */
+static void begin_move (fc_ai_t *ai)
+{
+	unsigned long size;
+
+	ai->age = (ai->age + 1) & 0xff;
+	age_history(ai);
+	if (ai->hash || (ai->algo != FC_NEGASCOUT && ai->algo != FC_MTDF)) {
+		return;
+	}
+	for (size = 2; size * 2 * sizeof(fc_ai_entry_t) <= ai->hash_memory;
+			size *= 2)
+		;
+	ai->hash = calloc(size, sizeof(fc_ai_entry_t));
+	ai->hash_size = (ai->hash) ? size : 0;
+}
+
+/*
+ * Negascout searches the forcing moves one ply deeper than the rest:  a move
+ * that checks an opponent's king, the only reply to a check, and a recapture
+ * which wins back what the last capture took all keep the depth left to
+ * search of the node they are made from.  The stacks are indexed by the
+ * distance from the bottom of the stacks rather than by the depth left, and
+ * they are taller than the search depth by MAX_EXTENSIONS(depth), which is
+ * the most extensions that any one path may take.  A node can afford an
+ * extension as long as its place in the stacks is higher than the depth it
+ * has left.
+ *
+ * With two opponents' kings to aim at, checks are much more common than in
+ * chess, so only MAX_CHECK_EXTENSIONS of them are extended on a path, and
+ * only if the checking piece cannot simply be won.
+ */
+#define MAX_EXTENSIONS(depth) ((depth) / 2)
+#define MAX_CHECK_EXTENSIONS 1
+
+/*
+ * The search window starts out wider than any score, win or loss, so that
+ * the bounds may be shifted by the king capture bonus without overflowing.
+ */
+#define ALPHA_MIN (-2 * FC_AI_WIN_SCORE)
+#define BETA_MAX (2 * FC_AI_WIN_SCORE)
+
+/*
+ * The state of a negascout node.  It is kept in a structure so that the
+ * search can run either recursively (see negascout()) or from an explicit
+ * stack that can be left and resumed (see fc_ai_slice_run()).  The depth
+ * passed along with a node is its place in the stacks.
+ */
+typedef struct {
+	fc_player_t player;
+	int alpha;
+	int beta;
+	int remaining; /* the depth left to search */
+	uint64_t target; /* the square captured on by the move into the node */
+	int target_value; /* the material value captured on target */
+	int checks; /* the checks extended on the path to the node */
+	int single; /* the player is in check and has a single reply */
+	int extend; /* move is searched without taking a ply off remaining */
+	int checking; /* move was extended as a check */
+	int pseudo; /* the moves are pseudo-legal (see init_pseudo_iterator()) */
+	int futile; /* the quiet moves after the first valid one are pruned */
+	int found; /* a valid move has been made */
+	int width; /* the most moves searched (see fc_ai_set_beam()); 0 if all */
+	int made; /* the moves made so far */
+	int b; /* the beta of the next null-window search */
+	int first; /* no move has been searched yet */
+	int negate; /* the node was passed on by players who are out */
+	int research; /* the child being searched is a full-window re-search */
+	int bonus; /* the king capture bonus of move */
+	fc_move_t *move; /* the move being searched */
+	fc_player_t next; /* the player to move after move */
+	int partner; /* next is on the same team as player */
+	uint64_t captured; /* the square that move captured on, if any */
+	int captured_value; /* the material value that move captured */
+	int alpha0; /* alpha before any move was searched */
+	int value; /* the best score of the moves searched */
+	fc_move_t best; /* the move that last raised alpha */
+	uint64_t key; /* the node's key in the table; 0 if not stored */
+	fc_mlist_t *ret;
+	fc_mlist_t *given;
+	fc_board_state_t state;
+	fc_mlist_iter_t iter;
+} node_t;
+
+/*
+ * Returns the value of the node to the caller, from the point of view of the
+ * player the node was opened for.
+ */
+static int node_value (node_t *n, int value)
+{
+	return (n->negate) ? -value : value;
+}
+
+/*
+ * Returns the number of moves that beam mode searches for player, or 0 if
+ * all of them are searched.  A player in check always gets his full width,
+ * since the way out may well be a quiet move far down the list.
+ */
+static int beam_width (fc_ai_t *ai, fc_board_t *board, fc_player_t player)
+{
+	int width;
+
+	if (player == ai->player) {
+		return 0;
+	}
+	width = (player == FC_PARTNER(ai->player)) ? ai->beam_partner :
+		ai->beam_opponent;
+	if (width && fc_board_in_check(board, player)) {
+		return 0;
+	}
+	return width;
+}
+
+/*
+ * Everything that negascout does at a node before it searches the node's
+ * moves.  The player, window, remaining depth, target, ret and given of the
+ * node must be set (see init_child()).  A player who is out of the game
+ * passes the node on to the next player, with the window negated; below the
+ * root, next_seat() has already skipped him.  Returns 1 (and sets value) if
+ * no move needs to be searched; otherwise the node's move iterator is left
+ * ready to use.
+ */
+static int open_node (fc_ai_t *ai, node_t *n, int depth, int *value)
+{
+	int futile, score, tmp;
+	uint64_t key;
+	fc_board_t *board;
+	fc_mlist_t *list;
+	fc_ai_entry_t *e;
+
+	board = &(ai->bv[depth]);
+	n->negate = 0;
+	for (;;) {
+		if (budget_spent(ai)) {
+			*value = node_value(n, n->beta);
+			return 1;
+		}
+		ai->pvl[depth] = 0;
+		if (fc_board_game_over(board) || n->remaining == 0) {
+			score = score_position(ai, board, n->player, depth);
+			*value = node_value(n, score);
+			return 1;
+		}
+		if (!fc_board_is_player_out(board, n->player)) {
+			break;
+		}
+		n->player = FC_NEXT_PLAYER(n->player);
+		tmp = n->alpha;
+		n->alpha = -n->beta;
+		n->beta = -tmp;
+		n->negate = !n->negate;
+		n->ret = NULL;
+		n->given = NULL;
+	}
+	/*
+	 * A repeated position is scored as even rather than searched again,
+	 * since the players could just keep going around the same cycle.
+	 */
+	key = fc_ai_node_key(board, n->player);
+	if (is_repetition(ai, depth, key) && !n->ret) {
+		*value = node_value(n, DRAW_SCORE);
+		return 1;
+	}
+	if (mate_distance_cutoff(ai, depth, &(n->alpha), &(n->beta))) {
+		*value = node_value(n, n->alpha);
+		return 1;
+	}
+
+	/*
+	 * The table only cuts off the null-window searches, so the principal
+	 * variation is never cut short.
+	 */
+	e = NULL;
+	n->key = 0;
+	if (ai->hash && !n->given) {
+		n->key = table_key(ai, key);
+		e = hash_entry(ai, n->key, 0);
+		if (e && !n->ret && n->beta - n->alpha == 1 &&
+				e->depth >= n->remaining) {
+			score = value_from_hash(e->value, ai->depth - depth);
+			if (e->bound != HASH_LOWER && score <= n->alpha) {
+				*value = node_value(n, score);
+				return 1;
+			} else if (e->bound != HASH_UPPER && score >= n->beta) {
+				*value = node_value(n, score);
+				return 1;
+			}
+		}
+	}
+
+	/*
+	 * Near the leaves, a position whose static score is hopelessly below
+	 * alpha is only searched for the moves that change the material:  at
+	 * frontier nodes the quiet moves are pruned, and pre-frontier nodes
+	 * are razored down to a capture-only search.  Neither is safe while
+	 * the player is in check.  The moves left out are taken to score no
+	 * more than the static score plus the margin, which is the most the
+	 * node returns if it fails low.
+	 */
+	futile = 0;
+	n->value = ALPHA_MIN;
+	if (ai->futility && !n->ret && n->remaining <= 2) {
+		score = fc_board_score_position(board, n->player);
+		if (n->remaining == 1 &&
+				score + FUTILITY_MARGIN(board) <= n->alpha &&
+				!fc_board_check_status(board, n->player)) {
+			futile = 1;
+			n->value = score + FUTILITY_MARGIN(board);
+		} else if (n->remaining == 2 &&
+				score + RAZOR_MARGIN(board) <= n->alpha &&
+				!fc_board_check_status(board, n->player)) {
+			tmp = quiesce(ai, n->player, depth, 2, n->alpha,
+					n->alpha + 1);
+			if (tmp <= n->alpha) {
+				score += RAZOR_MARGIN(board);
+				*value = node_value(n, (tmp > score) ? tmp :
+						score);
+				return 1;
+			}
+		}
+	}
+
+	/*
+	 * The root always gets the full validity checks, so that the moves
+	 * it returns are valid.
+	 */
+	list = &(ai->mlv[depth - 1]);
+	n->pseudo = (ai->pseudo_legal && !n->ret && !n->given &&
+			!fc_board_in_check(board, n->player));
+	n->futile = futile;
+	n->found = 0;
+	n->width = beam_width(ai, board, n->player);
+	n->made = 0;
+	if (n->pseudo) {
+		fc_mlist_clear(list);
+		fc_board_get_all_moves(board, list, n->player);
+		init_pseudo_iterator(&(n->iter), &(n->state), list, board,
+				n->player);
+	} else {
+		create_mlist_iterator(&(n->iter), n->given, &(n->state), list,
+				board, n->player);
+		if (futile) {
+			fc_mlist_iter_init(list, &(n->iter),
+					get_next_futile_move);
+			fc_mlist_iter_set_state(&(n->iter), &(n->state));
+		}
+	}
+
+	/*
+	 * The moves of a player in check are all checked for validity up
+	 * front, to find out whether there is only one.  The iterator drops
+	 * the invalid moves from the list as it goes.
+	 */
+	n->single = 0;
+	if (!n->given && n->state.current_check_status &&
+			depth > n->remaining) {
+		while (fc_mlist_iter_next(&(n->iter)))
+			;
+		fc_mlist_iter_init(list, &(n->iter), return_move);
+		n->single = (fc_mlist_length(list) == 1);
+	}
+	if (!n->given) {
+		order_quiet_moves(ai, list, depth);
+		if (e && e->move) {
+			order_hash_move(list, e);
+		}
+		order_pv_move(ai, list, depth);
+	}
+	n->first = 1;
+	n->b = n->beta;
+	n->alpha0 = n->alpha;
+	n->best.move = 0;
+	return 0;
+}
+
+/*
+ * Decides whether the node's move, which has been made on copy, is extended.
+ * The check test reuses fc_board_in_check(), without the search for a way
+ * out that fc_board_check_status() would make.
+ */
+static void extend_move (fc_ai_t *ai, node_t *n, int depth, fc_board_t *copy)
+{
+	fc_player_t opp;
+
+	n->extend = 0;
+	n->checking = 0;
+	/* the path has already taken all the extensions it may */
+	if (depth <= n->remaining) {
+		return;
+	}
+	if (n->single || ((n->captured & n->target) &&
+				n->captured_value == n->target_value)) {
+		n->extend = 1;
+		return;
+	}
+	if (n->checks >= MAX_CHECK_EXTENSIONS) {
+		return;
+	}
+	opp = FC_NEXT_PLAYER(n->player);
+	if ((fc_board_in_check(copy, opp) ||
+			fc_board_in_check(copy, FC_PARTNER(opp))) &&
+			fc_board_see(&(ai->bv[depth]), n->move) >= 0) {
+		n->extend = 1;
+		n->checking = 1;
+	}
+}
+
+/*
+ * Makes the next move of the node on the board below it.  Returns 0 if there
+ * are no more moves.
+ *
+ * A pseudo-legal move that turns out to be invalid is skipped.  If none of
+ * them is valid, the player may have to remove a piece instead, so the moves
+ * are generated again with the full checks, which fall back on the removes
+ * just as they would have without pseudo-legal mode.  At a futile node, the
+ * quiet moves are dropped once a valid move has been found, as
+ * get_next_futile_move() would.
+ */
+static int make_next_move (fc_ai_t *ai, node_t *n, int depth)
+{
+	fc_board_t *board, *copy;
+	fc_mlist_t *list;
+
+	board = &(ai->bv[depth]);
+	copy = &(ai->bv[depth - 1]);
+	list = &(ai->mlv[depth - 1]);
+	if (n->width && n->made == n->width) {
+		return 0;
+	}
+	for (;;) {
+		if (!fc_mlist_iter_next(&(n->iter))) {
+			if (!n->pseudo || n->found) {
+				return 0;
+			}
+			n->pseudo = 0;
+			create_mlist_iterator(&(n->iter), NULL, &(n->state),
+					list, board, n->player);
+			continue;
+		}
+		fc_board_copy(copy, board);
+		n->move = fc_mlist_iter_get_move(&(n->iter));
+		fc_board_make_move(copy, n->move);
+		if (!n->pseudo) {
+			break;
+		}
+		if (is_legal(&(n->state), copy)) {
+			if (n->futile && !n->found) {
+				drop_quiet_moves(board, list,
+					fc_mlist_iter_get_index(&(n->iter)));
+			}
+			n->found = 1;
+			break;
+		}
+	}
+	n->captured = 0;
+	n->captured_value = 0;
+	if (n->move->opp_piece != FC_NONE) {
+		n->captured = n->move->move &
+			~FC_BITBOARD(board, n->player, n->move->piece);
+		n->captured_value = fc_board_get_material_value(board,
+				n->move->opp_piece);
+	}
+	n->bonus = king_capture_bonus(copy, n->move, n->remaining);
+	n->next = next_seat(ai, copy, n->player);
+	n->partner = same_team(n->next, n->player);
+	extend_move(ai, n, depth, copy);
+	note_move(ai, depth, n->move);
+	n->made++;
+	return 1;
+}
+
+/*
+ * Sets the window in which the child of the node is searched, so that its
+ * value falls between the node's alpha and beta.  When a partner moves next,
+ * as one of them does in a game of three players, the window is shifted
+ * rather than negated.
+ */
+static void child_window (node_t *n, int beta, int *child_alpha,
+		int *child_beta)
+{
+	if (n->partner) {
+		*child_alpha = remove_bonus(n->bonus, n->alpha);
+		*child_beta = remove_bonus(n->bonus, beta);
+	} else {
+		*child_alpha = -remove_bonus(n->bonus, beta);
+		*child_beta = -remove_bonus(n->bonus, n->alpha);
+	}
+}
+
+/*
+ * Returns the score of the node's move given the value of the child.
+ */
+static int child_score (node_t *n, int value)
+{
+	return add_bonus(n->bonus, (n->partner) ? value : -value);
+}
+
+/*
+ * Sets up the child of the node for a search of the node's move with the
+ * given beta.
+ */
+static void init_child (node_t *n, node_t *child, int beta)
+{
+	child->player = n->next;
+	child_window(n, beta, &(child->alpha), &(child->beta));
+	child->remaining = n->remaining - 1 + n->extend;
+	child->target = n->captured;
+	child->target_value = n->captured_value;
+	child->checks = n->checks + n->checking;
+	child->ret = NULL;
+	child->given = NULL;
+}
+
+/*
+ * Takes the final score of the node's move into account.  Returns 1 if the
+ * score was a cutoff.
+ */
+static int score_move (fc_ai_t *ai, node_t *n, int depth, int score)
+{
+	n->first = 0;
+	if (score > n->value) {
+		n->value = score;
+	}
+	if (n->ret) {
+		fc_mlist_insert(n->ret, n->move, score);
+	}
+	if (score > n->alpha) {
+		update_pv(ai, depth, n->move);
+		fc_move_copy(&(n->best), n->move);
+	}
+	if (negascout_cutoff(score, &(n->alpha), &(n->beta))) {
+		record_cutoff(ai, n->move, depth, n->remaining);
+		return 1;
+	}
+	n->b = n->alpha + 1;
+	return 0;
+}
+
+/*
+ * The value of a node is its alpha, unless no move got above alpha.  Then the
+ * best score of its moves is a tighter upper bound, which the null-window
+ * searches of FC_MTDF need to get anywhere (the search "fails soft").  That
+ * bound does not hold if some of the moves were skipped without a score.
+ */
+static int fail_low_value (node_t *n)
+{
+	if (n->alpha > n->alpha0 || n->value == ALPHA_MIN ||
+			(n->width && n->made == n->width)) {
+		return n->alpha;
+	}
+	return n->value;
+}
+
+/*
+ * Stores the result of the node in the transposition table (unless the
+ * search was stopped before it could finish the node) and returns it.
+ */
+static int close_node (fc_ai_t *ai, node_t *n, int depth)
+{
+	int value;
+	fc_ai_entry_t *e;
+
+	if (n->ret) {
+		append_remaining_moves_onto_list(n->ret, &(n->iter));
+	}
+	value = fail_low_value(n);
+	if (n->key && !ai->stopped) {
+		e = hash_entry(ai, n->key, 1);
+		e->key = n->key;
+		e->move = n->best.move;
+		e->piece = n->best.piece;
+		e->promote = n->best.promote;
+		e->value = value_to_hash(value, ai->depth - depth);
+		e->depth = (n->remaining < 255) ? n->remaining : 255;
+		e->age = ai->age;
+		if (n->alpha <= n->alpha0) {
+			e->bound = HASH_UPPER;
+		} else if (n->alpha >= n->beta) {
+			e->bound = HASH_LOWER;
+		} else {
+			e->bound = HASH_EXACT;
+		}
+	}
+	return node_value(n, value);
+}
+
+/*
+ * Searches the node, which has been set up by init_child() or init_root(),
+ * and returns its value.
+ */
+static int negascout (fc_ai_t *ai, node_t *n, int depth)
+{
+	int score;
+	node_t child;
+
+	if (open_node(ai, n, depth, &score)) {
+		return score;
+	}
+
+	while (make_next_move(ai, n, depth)) {
+		init_child(n, &child, n->b);
+		score = child_score(n, negascout(ai, &child, depth - 1));
+		ai->follow_pv = 0;
+
+		if (!n->first && n->alpha < score && score < n->beta) {
+			init_child(n, &child, n->beta);
+			score = child_score(n, negascout(ai, &child,
+						depth - 1));
+		}
+
+		if (score_move(ai, n, depth, score)) {
+			break;
+		}
+	}
+
+	return close_node(ai, n, depth);
+}
+
+/*
+ * Best-Reply Search.  Rather than letting each of the other three players
+ * move in turn, only the root player's moves are searched, each followed by
+ * a single ply in which the moves of BOTH opponents are tried and only the
+ * best of them is played.  The partner's pieces stay where they are (unless
+ * the root player has been eliminated, in which case the partner moves in
+ * his place).
+ *
+ * The player parameter is always the root player; our_turn is set when the
+ * root player's team is to move.  Like negascout, the score is from the
+ * point of view of the side to move.
+ */
+static int brs (fc_ai_t *ai, fc_mlist_t *ret, fc_mlist_t *given,
+		fc_player_t player, int depth, int alpha, int beta,
+		int our_turn)
+{
+	int bonus, cut, i, ply, nmovers, score;
+	fc_board_t *board, *copy;
+	fc_board_state_t state;
+	fc_move_t *move;
+	fc_mlist_t *list;
+	fc_mlist_iter_t iter;
+	fc_player_t movers[2], tmp;
+
+	if (budget_spent(ai)) {
+		return beta;
+	}
+	board = &(ai->bv[depth]);
+	ai->pvl[depth] = 0;
+	if (fc_board_game_over(board) || depth == 0) {
+		score = score_position(ai, board, player, depth);
+		return (our_turn) ? score : -score;
+	}
+	if (mate_distance_cutoff(ai, depth, &alpha, &beta)) {
+		return alpha;
+	}
+
+	nmovers = 0;
+	if (our_turn) {
+		movers[nmovers++] = (fc_board_is_player_out(board, player)) ?
+			FC_PARTNER(player) : player;
+	} else {
+		for (i = 1; i <= 3; i += 2) {
+			tmp = (player + i) % FC_NUM_PLAYERS;
+			if (!fc_board_is_player_out(board, tmp)) {
+				movers[nmovers++] = tmp;
+			}
+		}
+		/* search the opponent on the principal variation first */
+		ply = ai->depth - depth;
+		if (nmovers == 2 && ai->follow_pv && ply < ai->pv_length &&
+				ai->pv[ply].player == movers[1]) {
+			movers[1] = movers[0];
+			movers[0] = ai->pv[ply].player;
+		}
+	}
+
+	copy = &(ai->bv[depth - 1]);
+	list = &(ai->mlv[depth - 1]);
+	for (i = 0, cut = 0; i < nmovers && !cut; i++) {
+		create_mlist_iterator(&iter, given, &state, list, board,
+				movers[i]);
+		if (!given) {
+			order_pv_move(ai, list, depth);
+		}
+		while (!cut && fc_mlist_iter_next(&iter)) {
+			fc_board_copy(copy, board);
+			move = fc_mlist_iter_get_move(&iter);
+			fc_board_make_move(copy, move);
+
+			bonus = king_capture_bonus(copy, move, depth);
+			score = add_bonus(bonus, -brs(ai, NULL, NULL, player,
+					depth - 1, -remove_bonus(bonus, beta),
+					-remove_bonus(bonus, alpha), !our_turn));
+			ai->follow_pv = 0;
+
+			if (ret) {
+				fc_mlist_insert(ret, move, score);
+			}
+
+			if (score > alpha) {
+				update_pv(ai, depth, move);
+			}
+
+			cut = negascout_cutoff(score, &alpha, &beta);
+		}
+	}
+
+	if (ret) {
 		append_remaining_moves_onto_list(ret, &iter);
 	}
 
-	return alpha;
+	return alpha;
+}
+
+/*
+ * The most that the max^n scores for material can add up to anywhere below
+ * the root.  The material on the board only grows when a pawn is promoted, so
+ * each pawn adds the largest gain that a promotion can bring.
+ */
+static int maxn_bound (fc_board_t *board)
+{
+	int i, gain, headroom, sum;
+	int scores[FC_NUM_PLAYERS];
+	fc_piece_t piece;
+
+	headroom = 0;
+	for (piece = FC_BISHOP; piece <= FC_QUEEN; piece++) {
+		gain = fc_board_get_material_value(board, piece) -
+			fc_board_get_material_value(board, FC_PAWN);
+		if (gain > headroom) {
+			headroom = gain;
+		}
+	}
+
+	fc_board_score_players(board, scores);
+	sum = 0;
+	for (i = 0; i < FC_NUM_PLAYERS; i++) {
+		sum += scores[i];
+		sum += 3 * headroom *
+			fc_popcount(FC_BITBOARD(board, i, FC_PAWN));
+	}
+	return sum;
+}
+
+/*
+ * As with king_capture_bonus(), the winners of a finished game get the number
+ * of plies left in the search on top of their scores, so that the quickest
+ * win is preferred.
+ */
+static void maxn_win_bonus (fc_board_t *board, int depth, int *scores)
+{
+	int i;
+
+	if (!fc_board_game_over(board)) {
+		return;
+	}
+	for (i = 0; i < FC_NUM_PLAYERS; i++) {
+		if (!fc_board_is_player_out(board, i) ||
+				!fc_board_is_player_out(board, FC_PARTNER(i))) {
+			scores[i] += depth;
+		}
+	}
+}
+
+/*
+ * Max^n.  Rather than treating the game as one team against the other, each
+ * player maximizes its own entry in a tuple of scores (see
+ * fc_board_score_players()), and the tuple of the best move is returned in
+ * scores.
+ *
+ * The scores are never negative and never add up to more than ai->maxsum.  So
+ * once the score of the player to move reaches bound, the player who moved
+ * into this node can no longer gain anything from it (shallow pruning).  When
+ * that player is searching its last move, this node can also be cut off once
+ * its player's score exceeds spec:  at that point neither of the two players
+ * above it would choose this line (last-branch pruning).  spec is INT_MAX when
+ * last-branch pruning does not apply.
+ */
+static void maxn (fc_ai_t *ai, fc_mlist_t *ret, fc_mlist_t *given,
+		fc_player_t player, int depth, int bound, int spec, int *scores)
+{
+	int i, last, child_spec;
+	int child[FC_NUM_PLAYERS];
+	fc_board_t *board, *copy;
+	fc_board_state_t state;
+	fc_move_t *move;
+	fc_mlist_t *list;
+	fc_mlist_iter_t iter;
+
+	/* a score below zero will never be chosen by the player above us */
+	for (i = 0; i < FC_NUM_PLAYERS; i++) {
+		scores[i] = -1;
+	}
+	if (budget_spent(ai)) {
+		return;
+	}
+	board = &(ai->bv[depth]);
+	ai->pvl[depth] = 0;
+	if (fc_board_game_over(board) || depth == 0) {
+		fc_board_score_players(board, scores);
+		maxn_win_bonus(board, depth, scores);
+		return;
+	}
+	if (fc_board_is_player_out(board, player)) {
+		maxn(ai, NULL, NULL, FC_NEXT_PLAYER(player), depth, bound, spec,
+				scores);
+		return;
+	}
+
+	copy = &(ai->bv[depth - 1]);
+	list = &(ai->mlv[depth - 1]);
+	create_mlist_iterator(&iter, given, &state, list, board, player);
+	if (!given) {
+		order_pv_move(ai, list, depth);
+	}
+	while (fc_mlist_iter_next(&iter)) {
+		fc_board_copy(copy, board);
+		move = fc_mlist_iter_get_move(&iter);
+		fc_board_make_move(copy, move);
+
+		/*
+		 * The three players involved in last-branch pruning have to be
+		 * different players, so there must be at least three left.
+		 */
+		last = (fc_mlist_iter_get_index(&iter) ==
+			fc_mlist_length(fc_mlist_iter_get_mlist(&iter)) - 1);
+		child_spec = (last && fc_board_num_players(copy) >= 3) ?
+			bound - scores[player] : INT_MAX;
+		maxn(ai, NULL, NULL, FC_NEXT_PLAYER(player), depth - 1,
+				ai->maxsum - scores[player], child_spec, child);
+		ai->follow_pv = 0;
+
+		if (ret) {
+			fc_mlist_insert(ret, move, child[player]);
+		}
+
+		if (child[player] > scores[player]) {
+			for (i = 0; i < FC_NUM_PLAYERS; i++) {
+				scores[i] = child[i];
+			}
+			update_pv(ai, depth, move);
+		}
+
+		if (scores[player] >= bound || scores[player] > spec) {
+			break;
+		}
+	}
+
+	if (ret) {
+		append_remaining_moves_onto_list(ret, &iter);
+	}
 }
 
 /*
@@ -263,59 +1821,217 @@ int fc_ai_next_move (fc_ai_t *ai, fc_move_t *ret, fc_mlist_t *given,
 	return rc;
 }
 
-static void free_ai_mlists (fc_ai_t *ai, int depth)
+/*
+ * The boards, move lists and principal variation table of the search are
+ * kept from one search to the next.  They are sized for the deepest search so
+ * far, and only grow when a deeper one comes along.
+ */
+static void free_ai_stacks (fc_ai_t *ai)
 {
 	int i;
 
-	for (i = 0; i < depth; i++) {
+	for (i = 0; i < ai->stack_depth; i++) {
 		fc_mlist_free(&(ai->mlv[i]));
 	}
 	free(ai->mlv);
+	free(ai->bv);
+	free(ai->pvt);
+	free(ai->pvl);
 	ai->mlv = NULL;
+	ai->bv = NULL;
+	ai->pvt = NULL;
+	ai->pvl = NULL;
+	ai->stack_depth = 0;
+}
+
+static void initialize_ai_stacks (fc_ai_t *ai, int depth)
+{
+	int i;
+
+	if (depth > ai->stack_depth) {
+		free_ai_stacks(ai);
+		ai->mlv = calloc((unsigned int)depth, sizeof(fc_mlist_t));
+		for (i = 0; i < depth; i++) {
+			fc_mlist_init(&(ai->mlv[i]));
+		}
+		ai->bv = calloc(depth + 1, sizeof(fc_board_t));
+		ai->pvt = calloc((depth + 1) * depth, sizeof(fc_move_t));
+		ai->pvl = calloc(depth + 1, sizeof(int));
+		ai->stack_depth = depth;
+	}
+	fc_board_copy(&(ai->bv[depth]), ai->board);
+	ai->depth = depth;
+}
+
+static int same_position (fc_board_t *a, fc_board_t *b)
+{
+	return !memcmp(a->bitb, b->bitb, sizeof(a->bitb));
+}
+
+/*
+ * Drops the moves of the last principal variation which have been played on
+ * the board since the last search.  If the board is not a position along the
+ * old line, then the line is thrown away.
+ */
+static void align_pv (fc_ai_t *ai, fc_player_t player)
+{
+	int i, j;
+	fc_board_t board;
+
+	fc_board_copy(&board, &(ai->pv_board));
+	for (i = 0; i < ai->pv_length; i++) {
+		if (ai->pv[i].player == player &&
+				same_position(&board, ai->board)) {
+			for (j = i; j < ai->pv_length; j++) {
+				fc_move_copy(&(ai->pv[j - i]), &(ai->pv[j]));
+			}
+			ai->pv_length -= i;
+			return;
+		}
+		fc_board_make_move(&board, &(ai->pv[i]));
+	}
+	ai->pv_length = 0;
 }
 
-static void initialize_ai_mlists (fc_ai_t *ai, int depth)
+/*
+ * Remembers the best line from the root of the search for fc_ai_get_pv() and
+ * for ordering the next search.
+ */
+static void save_pv (fc_ai_t *ai)
 {
 	int i;
+	fc_move_t *line;
 
-	if (ai->mlv != NULL) {
-		free_ai_mlists(ai, depth);
+	line = ai->pvt + ai->depth * ai->depth;
+	ai->pv_length = ai->pvl[ai->depth];
+	if (ai->pv_length > FC_AI_MAX_PV) {
+		ai->pv_length = FC_AI_MAX_PV;
 	}
-	ai->mlv = calloc(depth, sizeof(fc_mlist_t));
-	for (i = 0; i < depth; i++) {
-		fc_mlist_init(&(ai->mlv[i]));
+	for (i = 0; i < ai->pv_length; i++) {
+		fc_move_copy(&(ai->pv[i]), line + i);
 	}
+	fc_board_copy(&(ai->pv_board), ai->board);
 }
 
-static void free_ai_boards (fc_ai_t *ai)
+int fc_ai_get_pv (fc_ai_t *ai, fc_move_t *line, int max)
 {
-	free(ai->bv);
-	ai->bv = NULL;
+	int i;
+
+	assert(ai && line);
+	for (i = 0; i < ai->pv_length && i < max; i++) {
+		fc_move_copy(line + i, &(ai->pv[i]));
+	}
+	return i;
+}
+
+/*
+ * Sets up the root node of a negascout search of the given depth.
+ */
+static void init_root (node_t *root, fc_mlist_t *ret, fc_mlist_t *given,
+		fc_player_t player, int depth)
+{
+	root->player = player;
+	root->alpha = ALPHA_MIN + 1;
+	root->beta = BETA_MAX;
+	root->remaining = depth;
+	root->target = 0;
+	root->target_value = 0;
+	root->checks = 0;
+	root->ret = ret;
+	root->given = given;
 }
 
-static void initialize_ai_boards (fc_ai_t *ai, int depth)
+/*
+ * MTD(f):  closes in on the value of the root with null-window negascout
+ * searches.  The first window is placed at a guess, the value of the
+ * player's last search, and each search after that is placed at the bound
+ * the last one returned, which takes few searches since negascout fails
+ * soft.  The searches go over much of the same tree, which the
+ * transposition table makes cheap.
+ *
+ * The ranked moves are those of the last search to fail high, whose first
+ * move is the best; the values of the others are only bounds.  The
+ * principal variation is saved after each such search, since a search that
+ * fails low at the root leaves none.
+ */
+static void mtdf (fc_ai_t *ai, fc_mlist_t *ret, fc_mlist_t *given,
+		fc_player_t player, int depth)
 {
-	if (ai->bv != NULL) {
-		free_ai_boards(ai);
+	int g, beta, lower, upper;
+	fc_mlist_t list;
+	node_t root;
+
+	fc_mlist_init(&list);
+	lower = ALPHA_MIN + 1;
+	upper = BETA_MAX;
+	g = ai->guess[player];
+	while (lower < upper) {
+		beta = (g <= lower) ? lower + 1 : g;
+		fc_mlist_clear(&list);
+		init_root(&root, &list, given, player, depth);
+		root.alpha = beta - 1;
+		root.beta = beta;
+		ai->follow_pv = (given == NULL);
+		g = negascout(ai, &root, ai->depth);
+		if (ai->stopped) {
+			break;
+		}
+		if (g >= beta) {
+			lower = g;
+			fc_mlist_copy(ret, &list);
+			save_pv(ai);
+		} else {
+			upper = g;
+		}
 	}
-	ai->bv = calloc(depth + 1, sizeof(fc_board_t));
-	fc_board_copy(&(ai->bv[depth]), ai->board);
+	if (fc_mlist_length(ret) == 0) {
+		fc_mlist_copy(ret, &list);
+	}
+	if (!ai->stopped) {
+		ai->guess[player] = lower;
+	}
+	fc_mlist_free(&list);
 }
 
-#define ALPHA_MIN INT_MIN
-#define BETA_MAX INT_MAX
+/*
+ * Runs one search of the given depth.  If the search is stopped early and
+ * keep_partial is not set, the principal variation of the last search is
+ * left alone.  The stacks are set up height plies tall, which is more than
+ * the depth if the search extends moves.
+ */
+static void open_search (fc_ai_t *ai, fc_mlist_t *given, fc_player_t player,
+		int height)
+{
+	initialize_ai_stacks(ai, height);
+	if (!reserve_keys(ai, ai->played + height + 1)) {
+		ai->played = 0;
+		reserve_keys(ai, height + 1);
+	}
+	ai->reversible[ai->played] = ai->played;
+	set_seats(ai, ai->board);
+	ai->player = player;
+	align_pv(ai, player);
+	ai->follow_pv = (given == NULL);
+}
 
-int fc_ai_next_ranked_moves (fc_ai_t *ai, fc_mlist_t *ret, fc_mlist_t *given,
-		fc_player_t player, int depth, unsigned int seconds)
+static void close_search (fc_ai_t *ai, int keep_partial)
 {
-	assert(ai && ai->board && ret);
-	if (fc_board_is_player_out(ai->board, player) || depth < 1) {
-		return 0;
+	if (!ai->stopped || keep_partial) {
+		save_pv(ai);
 	}
+}
 
-	initialize_ai_mlists(ai, depth);
-	initialize_ai_boards(ai, depth);
-	ai->timeout = (seconds) ? time(NULL) + seconds : 0;
+static void search (fc_ai_t *ai, fc_mlist_t *ret, fc_mlist_t *given,
+		fc_player_t player, int depth, int keep_partial)
+{
+	int scores[FC_NUM_PLAYERS];
+	node_t root;
+
+	if (ai->algo == FC_NEGASCOUT || ai->algo == FC_MTDF) {
+		open_search(ai, given, player, depth + MAX_EXTENSIONS(depth));
+	} else {
+		open_search(ai, given, player, depth);
+	}
 
 	switch (ai->algo) {
 	case FC_ALPHABETA:
@@ -323,16 +2039,429 @@ int fc_ai_next_ranked_moves (fc_ai_t *ai, fc_mlist_t *ret, fc_mlist_t *given,
 				1);
 		break;
 	case FC_NEGASCOUT:
-		negascout(ai, ret, given, player, depth, ALPHA_MIN + 1,
-				BETA_MAX);
+		init_root(&root, ret, given, player, depth);
+		negascout(ai, &root, ai->depth);
+		break;
+	case FC_MTDF:
+		/* mtdf() saves the principal variation itself */
+		mtdf(ai, ret, given, player, depth);
+		return;
+	case FC_BRS:
+		brs(ai, ret, given, player, depth, ALPHA_MIN + 1, BETA_MAX, 1);
+		break;
+	case FC_MAXN:
+		ai->maxsum = maxn_bound(ai->board) + FC_NUM_PLAYERS * depth;
+		maxn(ai, ret, given, player, depth, ai->maxsum + 1, INT_MAX,
+				scores);
 		break;
 	default:
 		assert(0);
 	}
 
-	free_ai_boards(ai);
-	free_ai_mlists(ai, depth);
+	close_search(ai, keep_partial);
+}
+
+/*
+ * Splits the game clock into a soft and a hard limit for this move, both in
+ * milliseconds.  Unless the caller knows how many moves are left before the
+ * next time control, each player still in the game is counted as making the
+ * game MOVES_PER_PLAYER moves longer.  The search may run past the soft limit
+ * if it has not settled on a move, but never past the hard limit, which keeps
+ * a reserve on the clock.
+ */
+static void allot_time (fc_ai_t *ai, long *soft, long *hard)
+{
+	long clock, reserve;
+	int moves;
+
+	clock = (long)ai->clock;
+	moves = (ai->moves_to_go > 0) ? ai->moves_to_go :
+		MOVES_PER_PLAYER * fc_board_num_players(ai->board);
+	reserve = clock / RESERVE_RATIO + RESERVE_MSECS;
+	*soft = clock / moves + (long)ai->increment * 3 / 4;
+	*hard = *soft * HARD_RATIO;
+	if (*hard > clock - reserve) {
+		*hard = (clock > reserve) ? clock - reserve : clock / 2;
+	}
+	if (*soft > *hard) {
+		*soft = *hard;
+	}
+}
+
+/*
+ * Searches one ply deeper at a time, from depth up to max_depth.  best holds
+ * the ranked moves of a search of depth - 1 (if there was one), and is left
+ * holding the ranked moves of the deepest search to finish.  Each search is
+ * ordered by the principal variation of the one before it.  A search that is
+ * stopped early is thrown away in favor of the last one to finish.
+ *
+ * With a game clock, another search is started as long as the time spent is
+ * under the soft limit, which is stretched while the best move keeps changing
+ * and shrunk once it has held for STABLE_ITERATIONS searches.  The hard limit
+ * stops the search wherever it is.
+ */
+static void iterative_deepening (fc_ai_t *ai, fc_mlist_t *best,
+		fc_mlist_t *given, fc_player_t player, int depth,
+		int max_depth)
+{
+	int stable;
+	long start, soft, hard, limit;
+	fc_mlist_t list;
+	fc_move_t *move;
+
+	start = now_in_ms();
+	soft = hard = 0;
+	if (ai->clock) {
+		allot_time(ai, &soft, &hard);
+		ai->deadline = start + hard;
+	}
+	fc_mlist_init(&list);
+
+	stable = 0;
+	for (; depth <= max_depth; depth++) {
+		fc_mlist_clear(&list);
+		search(ai, &list, given, player, depth,
+				fc_mlist_length(best) == 0);
+		if (ai->stopped && fc_mlist_length(best) > 0) {
+			break;
+		}
+		if (fc_mlist_length(best) > 0 && same_move(
+					fc_mlist_get(&list, 0),
+					fc_mlist_get(best, 0))) {
+			stable += 1;
+		} else {
+			stable = 0;
+		}
+		fc_mlist_copy(best, &list);
+		if (ai->stopped) {
+			break;
+		}
+
+		move = fc_mlist_get(best, 0);
+		if (ai->progress && move) {
+			ai->progress(ai->progress_data, depth, move->value,
+					ai->nodes, move);
+		}
+		if (!ai->clock) {
+			continue;
+		}
+		limit = soft;
+		if (depth > 1 && stable == 0) {
+			limit = soft * UNSTABLE_RATIO;
+		} else if (stable >= STABLE_ITERATIONS) {
+			limit = soft / 2;
+		}
+		if (now_in_ms() - start >= limit) {
+			break;
+		}
+	}
+
+	fc_mlist_free(&list);
+	ai->deadline = 0;
+}
+
+/*
+ * Looks for a move that needs no search:  the only legal move (or remove) or
+ * a king capture that ends the game.  If there is one, it becomes the whole
+ * ranked list and the principal variation, and 1 is returned.
+ */
+static int play_forced_move (fc_ai_t *ai, fc_mlist_t *ret, fc_mlist_t *given,
+		fc_player_t player)
+{
+	int i, found, score;
+	fc_board_t copy;
+	fc_mlist_t list;
+	fc_mlist_t *moves;
+	fc_move_t *move;
+
+	fc_mlist_init(&list);
+	moves = given;
+	if (!moves) {
+		fc_board_get_moves(ai->board, &list, player);
+		moves = &list;
+	}
+
+	found = 0;
+	for (i = 0; !found && i < fc_mlist_length(moves); i++) {
+		move = fc_mlist_get(moves, i);
+		if (move->opp_piece == FC_KING) {
+			fc_board_copy(&copy, ai->board);
+			fc_board_make_move(&copy, move);
+			found = fc_board_game_over(&copy);
+		}
+	}
+	if (!found && fc_mlist_length(moves) == 1) {
+		move = fc_mlist_get(moves, 0);
+		fc_board_copy(&copy, ai->board);
+		fc_board_make_move(&copy, move);
+		found = 1;
+	}
+
+	if (found) {
+		/* scored as a search of depth 1 would score it */
+		ai->depth = 1;
+		score = score_position(ai, &copy, player, 0);
+		fc_mlist_insert(ret, move, score);
+		fc_move_copy(&(ai->pv[0]), move);
+		ai->pv_length = 1;
+		fc_board_copy(&(ai->pv_board), ai->board);
+	}
+	fc_mlist_free(&list);
+	return found;
+}
+
+int fc_ai_next_ranked_moves (fc_ai_t *ai, fc_mlist_t *ret, fc_mlist_t *given,
+		fc_player_t player, int depth, unsigned int seconds)
+{
+	int pondered, rc;
+	long soft, hard;
+	unsigned long msecs;
+	fc_mlist_t best;
+
+	assert(ai && ai->board && ret);
+	if (fc_board_is_player_out(ai->board, player) || depth < 1) {
+		fc_ai_stop_pondering(ai);
+		return 0;
+	}
+	fc_mlist_init(&best);
+	pondered = fc_ai_collect_ponder(ai, player, &best);
+	if (given) {
+		fc_mlist_clear(&best);
+		pondered = 0;
+	}
+
+	ai->timeout = (seconds) ? time(NULL) + seconds : 0;
+	ai->nodes = 0;
+	ai->forced = (ai->forced_moves &&
+			play_forced_move(ai, ret, given, player));
+	if (ai->forced) {
+		fc_mlist_free(&best);
+		return 1;
+	}
+
+	if (ai->algo == FC_MCTS) {
+		fc_mlist_free(&best);
+		if (!ai->clock) {
+			return fc_ai_mcts(ai, ret, given, player, depth);
+		}
+		/* the playouts can stop at any time, so just use the soft
+		 * limit */
+		allot_time(ai, &soft, &hard);
+		msecs = ai->msecs;
+		ai->msecs = (soft > 0) ? (unsigned long)soft : 1;
+		rc = fc_ai_mcts(ai, ret, given, player, depth);
+		ai->msecs = msecs;
+		return rc;
+	}
+
+	/* the ponder search has already begun the move on the same tables */
+	if (!pondered) {
+		begin_move(ai);
+	}
+
+	/*
+	 * A search that may be cut short by the clock or by another thread
+	 * deepens one ply at a time, so that there is always a finished search
+	 * to fall back on.  So does one that picks up where the ponder search
+	 * left off.
+	 */
+	ai->stopped = 0;
+	if (ai->clock || ai->thread || pondered) {
+		iterative_deepening(ai, &best, given, player, pondered + 1,
+				depth);
+		fc_mlist_merge(ret, &best);
+	} else {
+		search(ai, ret, given, player, depth, 1);
+	}
+
+	fc_mlist_free(&best);
+	return 1;
+}
+
+/*
+ * A negascout search that runs from an explicit stack of nodes, indexed by
+ * depth like the boards and move lists, rather than from the C stack.  The
+ * node at top is the one being searched.  When a node is done, its value is
+ * left in value for the node above it to pick up.  The capture-only search
+ * which razoring drops into is still recursive, but it never runs more than
+ * two plies deep.
+ */
+struct fc_ai_slice_ {
+	node_t *nodes;
+	int depth; /* the height of the stacks (see MAX_EXTENSIONS()) */
+	int top; /* depth + 1 once the root is done */
+	int value;
+	int returned; /* the node below top has returned value */
+	fc_mlist_t moves;
+};
+
+static void return_from_node (fc_ai_slice_t *s, int value)
+{
+	s->value = value;
+	s->returned = 1;
+	s->top += 1;
+}
+
+static void enter_child (fc_ai_t *ai, fc_ai_slice_t *s, int beta)
+{
+	int value;
+	node_t *n, *child;
+
+	n = &(s->nodes[s->top]);
+	child = &(s->nodes[s->top - 1]);
+	init_child(n, child, beta);
+	s->top -= 1;
+	if (open_node(ai, child, s->top, &value)) {
+		return_from_node(s, value);
+	}
+}
+
+/*
+ * The body of the move loop in negascout(), split in two at the points where
+ * it would recurse.
+ */
+static void search_next_move (fc_ai_t *ai, fc_ai_slice_t *s)
+{
+	node_t *n = &(s->nodes[s->top]);
+
+	if (!make_next_move(ai, n, s->top)) {
+		return_from_node(s, close_node(ai, n, s->top));
+		return;
+	}
+	n->research = 0;
+	enter_child(ai, s, n->b);
+}
+
+static void finish_move (fc_ai_t *ai, fc_ai_slice_t *s)
+{
+	int score;
+	node_t *n = &(s->nodes[s->top]);
+
+	score = child_score(n, s->value);
+	s->returned = 0;
+	if (!n->research) {
+		ai->follow_pv = 0;
+		if (!n->first && n->alpha < score && score < n->beta) {
+			n->research = 1;
+			enter_child(ai, s, n->beta);
+			return;
+		}
+	}
+	if (score_move(ai, n, s->top, score)) {
+		return_from_node(s, close_node(ai, n, s->top));
+	}
+}
+
+int fc_ai_slice_start (fc_ai_t *ai, fc_mlist_t *given, fc_player_t player,
+		int depth)
+{
+	int value;
+	fc_ai_slice_t *s;
+	node_t *root;
+
+	assert(ai && ai->board && !ai->slice);
+	fc_ai_stop_pondering(ai);
+	if (fc_board_is_player_out(ai->board, player) || depth < 1) {
+		return 0;
+	}
+	s = malloc(sizeof(fc_ai_slice_t));
+	if (!s) {
+		return 0;
+	}
+	fc_mlist_init(&(s->moves));
+	s->nodes = NULL;
+	s->depth = depth;
+	s->top = depth + 1;
+	s->returned = 0;
+	ai->slice = s;
+
+	ai->timeout = 0;
+	ai->nodes = 0;
+	ai->stopped = 0;
+	ai->forced = (ai->forced_moves &&
+			play_forced_move(ai, &(s->moves), given, player));
+	if (ai->forced) {
+		return 1;
+	}
 
+	begin_move(ai);
+	s->depth = depth + MAX_EXTENSIONS(depth);
+	s->nodes = malloc((s->depth + 1) * sizeof(node_t));
+	if (!s->nodes) {
+		fc_ai_slice_finish(ai, NULL);
+		return 0;
+	}
+	open_search(ai, given, player, s->depth);
+	root = &(s->nodes[s->depth]);
+	init_root(root, &(s->moves), given, player, depth);
+	s->top = s->depth;
+	if (open_node(ai, root, s->top, &value)) {
+		return_from_node(s, value);
+	}
 	return 1;
 }
 
+int fc_ai_slice_run (fc_ai_t *ai, unsigned long nodes)
+{
+	unsigned long start;
+	fc_ai_slice_t *s;
+
+	assert(ai && ai->slice);
+	s = ai->slice;
+	start = ai->nodes;
+	while (s->top <= s->depth && (!nodes || ai->nodes - start < nodes)) {
+		if (s->returned) {
+			finish_move(ai, s);
+		} else {
+			search_next_move(ai, s);
+		}
+	}
+	return s->top > s->depth;
+}
+
+int fc_ai_slice_finish (fc_ai_t *ai, fc_mlist_t *moves)
+{
+	int done;
+	fc_ai_slice_t *s;
+
+	assert(ai && ai->slice);
+	s = ai->slice;
+	done = (s->top > s->depth);
+	if (s->nodes) {
+		if (!done) {
+			ai->stopped = 1;
+		}
+		close_search(ai, done);
+		free(s->nodes);
+	}
+	if (done && moves) {
+		fc_mlist_merge(moves, &(s->moves));
+	}
+	fc_mlist_free(&(s->moves));
+	free(s);
+	ai->slice = NULL;
+	return done;
+}
+
+void fc_ai_free (fc_ai_t *ai)
+{
+	assert(ai);
+	fc_ai_stop_pondering(ai);
+	if (ai->search) {
+		fc_ai_search_stop(ai);
+		fc_ai_search_wait(ai, NULL);
+	}
+	if (ai->slice) {
+		fc_ai_slice_finish(ai, NULL);
+	}
+	free_ai_stacks(ai);
+	free(ai->hash);
+	free(ai->keys);
+	free(ai->reversible);
+	ai->hash = NULL;
+	ai->hash_size = 0;
+	ai->keys = NULL;
+	ai->reversible = NULL;
+	ai->keys_size = 0;
+	ai->played = 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * LibForchess
+ * Copyright (c) 2011, Jason M Barnes
+ *
+ * This file is subject to the terms and conditions of the 'LICENSE' file
+ * which is a part of this source code package.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Counting and scanning the bits of a bitboard.  The portable versions are
+ * used unless the processor has instructions for the job, which is checked
+ * once, the first time that a board is initialized.
+ */
+
+/* needed for the pthreads API under -std=c89 */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <pthread.h>
+
+#include "forchess/board.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_CPU_DISPATCH
+#endif
+
+/* the masks of the bit counting tree; see also FC_LEFT_COL */
+#define MASK1 ((((uint64_t)0x55555555) << 32) | ((uint64_t)0x55555555))
+#define MASK2 ((((uint64_t)0x33333333) << 32) | ((uint64_t)0x33333333))
+#define MASK4 ((((uint64_t)0x0f0f0f0f) << 32) | ((uint64_t)0x0f0f0f0f))
+#define BYTES ((((uint64_t)0x01010101) << 32) | ((uint64_t)0x01010101))
+
+/*
+ * Adds up the bits in pairs, then in nibbles, then in bytes; the multiply
+ * sums the bytes into the top one.
+ */
+static int popcount_portable (uint64_t bb)
+{
+	bb -= (bb >> 1) & MASK1;
+	bb = (bb & MASK2) + ((bb >> 2) & MASK2);
+	bb = (bb + (bb >> 4)) & MASK4;
+	return (int)((bb * BYTES) >> 56);
+}
+
+/*
+ * Multiplying the lowest bit by a de Bruijn sequence puts a different pattern
+ * in the top six bits for each square.
+ */
+static int bitscan_portable (uint64_t bb)
+{
+	static const int index[64] = {
+		0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4,
+		62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+		63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+		46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6
+	};
+	const uint64_t debruijn = (((uint64_t)0x03F79D71) << 32) |
+		((uint64_t)0xB4CB0A89);
+
+	return index[((bb & (~bb + 1)) * debruijn) >> 58];
+}
+
+#ifdef HAVE_CPU_DISPATCH
+__attribute__((target("popcnt")))
+static int popcount_popcnt (uint64_t bb)
+{
+	return __builtin_popcountll(bb);
+}
+
+__attribute__((target("bmi")))
+static int bitscan_tzcnt (uint64_t bb)
+{
+	return __builtin_ctzll(bb);
+}
+#endif
+
+static int (*popcount)(uint64_t) = popcount_portable;
+static int (*bitscan)(uint64_t) = bitscan_portable;
+static pthread_once_t selected = PTHREAD_ONCE_INIT;
+
+static void select_instructions (void)
+{
+#ifdef HAVE_CPU_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("popcnt")) {
+		popcount = popcount_popcnt;
+	}
+	if (__builtin_cpu_supports("bmi")) {
+		bitscan = bitscan_tzcnt;
+	}
+#endif
+}
+
+void fc_bits_init (void)
+{
+	pthread_once(&selected, select_instructions);
+}
+
+int fc_popcount (uint64_t bb)
+{
+	return popcount(bb);
+}
+
+int fc_bitscan (uint64_t bb)
+{
+	assert(bb);
+	return bitscan(bb);
+}
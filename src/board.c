@@ -37,6 +37,20 @@ static void update_empty_positions (fc_board_t *b)
 			FC_ALL_PIECES(b, 3));
 }
 
+/*
+ * The piece-square value of the piece on bit, from the table of the given seat
+ * (the piece's owner or, for a pawn, its orientation).  Returns 0 if the board
+ * has no tables or there is no bit.
+ */
+static int square_value (fc_board_t *board, fc_player_t seat,
+		fc_piece_t piece, uint64_t bit)
+{
+	if (!board->pst || !bit) {
+		return 0;
+	}
+	return board->pst->value[seat][piece][fc_bitscan(bit)];
+}
+
 static void set_material_values_to_defaults (fc_board_t *board)
 {
 	fc_piece_t i;
@@ -59,6 +73,7 @@ static void set_material_values_to_defaults (fc_board_t *board)
  */
 void fc_board_init (fc_board_t *board)
 {
+	fc_bits_init();
 	bzero(board->bitb, sizeof(fc_board_t));
 	update_empty_positions(board);
 	set_material_values_to_defaults(board);
@@ -77,6 +92,11 @@ int fc_board_set_piece (fc_board_t *board, fc_player_t player, fc_piece_t piece,
 	 * FIXME also make sure we don't call it with bad row/col values.
 	 */
 	bb = ((uint64_t)1) << (row * 8 + col);
+	if (!(FC_BITBOARD(board, player, piece) & bb)) {
+		board->material[player] += board->piece_value[piece];
+		board->positional[player] += square_value(board, player, piece,
+				bb);
+	}
 	FC_BITBOARD(board, player, piece) |= bb;
 	if (piece == FC_PAWN) {
 		FC_PAWN_BB(board, player) |= bb;
@@ -139,7 +159,7 @@ int fc_board_remove_piece (fc_board_t *board, int row, int col)
 {
 	int i;
 	uint64_t bit;
-	fc_player_t player;
+	fc_player_t player, seat;
 	fc_piece_t piece;
 
 	assert(board);
@@ -148,10 +168,15 @@ int fc_board_remove_piece (fc_board_t *board, int row, int col)
 	bit = ((uint64_t)1) << (row * 8 + col);
 	for (i = 0; i < 24; i++) {
 		if (board->bitb[i] & bit) {
+			seat = (piece == FC_PAWN) ?
+				fc_get_pawn_orientation(board, bit) : player;
+			board->positional[player] -= square_value(board, seat,
+					piece, bit);
 			if (piece == FC_PAWN) {
 				FC_PAWN_BB(board, player) ^= bit;
 			}
 			board->bitb[i] ^= bit;
+			board->material[player] -= board->piece_value[piece];
 			update_empty_positions(board);
 			return 1;
 		}
@@ -159,11 +184,66 @@ int fc_board_remove_piece (fc_board_t *board, int row, int col)
 	return 0;
 }
 
+/*
+ * Adds up the value of each player's pieces from scratch.
+ */
+static void count_material (fc_board_t *board)
+{
+	fc_piece_t i;
+	fc_player_t p;
+
+	for (p = FC_FIRST; p <= FC_FOURTH; p++) {
+		board->material[p] = 0;
+		for (i = FC_PAWN; i <= FC_KING; i++) {
+			board->material[p] += board->piece_value[i] *
+				fc_popcount(FC_BITBOARD(board, p, i));
+		}
+	}
+}
+
+/*
+ * Adds up player's piece-square values from scratch.
+ */
+static int count_positional (fc_board_t *board, fc_player_t player)
+{
+	int ret = 0;
+	uint64_t piece, pieces;
+	fc_piece_t i;
+	fc_player_t side;
+
+	for (i = FC_BISHOP; i <= FC_KING; i++) {
+		pieces = FC_BITBOARD(board, player, i);
+		FC_FOREACH(piece, pieces) {
+			ret += square_value(board, player, i, piece);
+		}
+	}
+	for (side = FC_FIRST; side <= FC_FOURTH; side++) {
+		pieces = FC_BITBOARD(board, player, FC_PAWN) &
+			FC_PAWN_BB(board, side);
+		FC_FOREACH(piece, pieces) {
+			ret += square_value(board, side, FC_PAWN, piece);
+		}
+	}
+	return ret;
+}
+
+void fc_board_set_pst (fc_board_t *board, const fc_pst_t *pst)
+{
+	fc_player_t p;
+
+	assert(board);
+	board->pst = pst;
+	for (p = FC_FIRST; p <= FC_FOURTH; p++) {
+		board->positional[p] = count_positional(board, p);
+	}
+}
+
 void fc_board_set_material_value (fc_board_t *board, fc_piece_t piece,
 		int value)
 {
 	assert(board);
 	board->piece_value[piece] = value;
+	count_material(board);
 }
 
 int fc_board_get_material_value (fc_board_t *board, fc_piece_t piece)
@@ -178,6 +258,10 @@ int fc_board_get_material_value (fc_board_t *board, fc_piece_t piece)
  *     3 K h8
  * etc.
  *
+ * The pieces are added to whatever is on the board already.  The material
+ * and piece-square sums are counted over first, since the caller may have
+ * cleared the bitboards without them (see fc_game_load()).
+ *
  * TODO make this function prettier and more robust.  For example, currently
  * two different pieces are allowed to occupy the same space; we should
  * probably fail if that is the case.  Also think about adding errno.
@@ -197,6 +281,8 @@ int fc_board_setup (fc_board_t *board, const char *filename, fc_player_t *first)
 	}
 
 	*first = FC_NONE;
+	count_material(board);
+	fc_board_set_pst(board, board->pst);
 
 	read = fscanf(fp, "%d %c %c%c \n", &player, &piece, &col, &row);
 	while (read != EOF) {
@@ -244,20 +330,36 @@ int fc_board_setup (fc_board_t *board, const char *filename, fc_player_t *first)
 	return 1;
 }
 
+/*
+ * Most valuable victim, least valuable attacker:  a move is ranked by the
+ * material it wins, counting a promotion as the gain over the pawn, and ties
+ * are broken in favor of the cheaper piece.  A pawn move that must promote,
+ * but whose piece has not been chosen yet, is ranked as a promotion to a
+ * queen.  Quiet moves rank 0.
+ */
 static int32_t quick_rank_move (fc_board_t *board, fc_move_t *move)
 {
-	int32_t ret = 0;
+	int32_t gain = 0;
+	fc_piece_t promote;
+	fc_player_t side;
 
-	if (move->opp_piece != FC_NONE) {
-		ret += board->piece_value[move->opp_piece];
+	promote = move->promote;
+	if (promote == FC_NONE &&
+			fc_board_move_requires_promotion(board, move, &side)) {
+		promote = FC_QUEEN;
 	}
-	/* FIXME Why does taking the promotion into account crash the AI?
-	if (move->promote != FC_NONE) {
-		ret += board->piece_value[move->promote];
+	if (move->opp_piece == FC_NONE && promote == FC_NONE) {
+		return 0;
 	}
-	*/
 
-	return ret;
+	if (move->opp_piece != FC_NONE) {
+		gain += board->piece_value[move->opp_piece];
+	}
+	if (promote != FC_NONE) {
+		gain += board->piece_value[promote] -
+			board->piece_value[FC_PAWN];
+	}
+	return gain * FC_NUM_PIECES + (FC_KING - move->piece);
 }
 
 int fc_board_list_add_move (fc_board_t *board, fc_mlist_t *list,
@@ -810,18 +912,26 @@ int fc_board_is_move_valid (fc_board_t *board, fc_move_t *move)
 			check_status_before, partner_status_before);
 }
 
-static void append_pawn_promotions_to_moves(fc_board_t *board, fc_mlist_t *list,
-		fc_move_t *move)
+/*
+ * Replaces the pawn move at index with one move for each piece the pawn may
+ * be promoted to.  The new moves are placed at or after index, since the
+ * iterator has already passed the moves before it, and they are inserted
+ * from a copy because the move in the list is shifted by the inserts.
+ */
+static void append_pawn_promotions_to_moves (fc_board_t *board,
+		fc_mlist_t *list, int index)
 {
-	move->promote = FC_QUEEN;
-	fc_board_list_add_move(board, list, move);
-	move->promote = FC_KNIGHT;
-	fc_board_list_add_move(board, list, move);
-	move->promote = FC_ROOK;
-	fc_board_list_add_move(board, list, move);
-	move->promote = FC_BISHOP;
-	fc_board_list_add_move(board, list, move);
-	move->promote = FC_NONE;
+	int i;
+	fc_move_t move;
+	fc_piece_t promotions[] = {FC_QUEEN, FC_KNIGHT, FC_ROOK, FC_BISHOP};
+
+	fc_move_copy(&move, fc_mlist_get(list, index));
+	fc_mlist_delete(list, index);
+	for (i = 0; i < 4; i++) {
+		move.promote = promotions[i];
+		fc_mlist_insert_from(list, index, &move,
+				quick_rank_move(board, &move));
+	}
 }
 
 /*
@@ -888,6 +998,7 @@ void fc_board_state_init (fc_board_state_t *state, fc_board_t *board,
 			FC_PARTNER(player));
 	state->all_moves_are_invalid = 1;
 	state->initial_flag = 1;
+	state->allow_removes = 1;
 }
 
 fc_move_t *fc_board_get_next_move (fc_mlist_iter_t *iter)
@@ -921,15 +1032,14 @@ fc_move_t *fc_board_get_next_move (fc_mlist_iter_t *iter)
 
 		if (fc_board_move_requires_promotion(board, ret, &dummy) &&
 				ret->promote == FC_NONE) {
-			append_pawn_promotions_to_moves(board, list, ret);
-			fc_mlist_delete(list, i);
+			append_pawn_promotions_to_moves(board, list, i);
 			continue;
 		}
 		state->all_moves_are_invalid = 0;
 		break;
 	}
 
-	if (state->all_moves_are_invalid) {
+	if (state->all_moves_are_invalid && state->allow_removes) {
 		fc_mlist_clear(list);
 		fc_mlist_iter_set_index(iter, 0);
 		get_valid_removes(board, list, state->player);
@@ -939,6 +1049,35 @@ fc_move_t *fc_board_get_next_move (fc_mlist_iter_t *iter)
 	return ret;
 }
 
+/*
+ * Like fc_board_get_next_move(), but without the validity checks:  the moves
+ * are returned as fc_board_get_all_moves() made them, apart from a pawn move
+ * that needs a promotion, which is replaced by one move per promotion.  Only
+ * the board of the state is used.
+ */
+fc_move_t *fc_board_get_next_pseudo_move (fc_mlist_iter_t *iter)
+{
+	int i;
+	fc_move_t *ret;
+	fc_player_t dummy;
+	fc_board_state_t *state;
+	fc_mlist_t *list;
+
+	i = fc_mlist_iter_get_index(iter);
+	list = fc_mlist_iter_get_mlist(iter);
+	state = fc_mlist_iter_get_state(iter);
+
+	/* the promotions may sort behind another pawn move which needs its
+	 * own promotions */
+	while ((ret = fc_mlist_get(list, i)) != NULL &&
+			ret->promote == FC_NONE &&
+			fc_board_move_requires_promotion(state->board, ret,
+				&dummy)) {
+		append_pawn_promotions_to_moves(state->board, list, i);
+	}
+	return ret;
+}
+
 /*
  * Return only the moves that are valid and legal.  Returns all moves that do
  * not put player's or player's partner's king in check.  If no valid, legal
@@ -968,7 +1107,8 @@ void fc_board_get_moves (fc_board_t *board, fc_mlist_t *list,
 }
 
 /*
- * Give all player 'from's pieces to player 'to'.
+ * Give all player 'from's pieces to player 'to'.  The king has already been
+ * captured, so the material that is left goes to 'to' as a whole.
  */
 static void fc_convert_pieces (fc_board_t *board, fc_player_t from,
 		fc_player_t to)
@@ -989,6 +1129,11 @@ static void fc_convert_pieces (fc_board_t *board, fc_player_t from,
 		FC_BITBOARD(board, to, j) |= FC_BITBOARD(board, from, j);
 		FC_BITBOARD(board, from, j) = ((uint64_t)0);
 	}
+	board->material[to] += board->material[from];
+	board->material[from] = 0;
+	/* the pieces now use the tables of their new seat */
+	board->positional[to] = count_positional(board, to);
+	board->positional[from] = 0;
 }
 
 /*
@@ -1042,6 +1187,11 @@ static void update_enemy_bitboards (fc_board_t *board, fc_move_t *move,
 	assert(bit);
 
 	FC_BITBOARD(board, move->opp_player, move->opp_piece) ^= bit;
+	board->material[move->opp_player] -=
+		board->piece_value[move->opp_piece];
+	board->positional[move->opp_player] -= square_value(board,
+			(move->opp_piece == FC_PAWN) ? side : move->opp_player,
+			move->opp_piece, bit);
 	if (move->opp_piece == FC_PAWN) {
 		assert(side != FC_NONE);
 		FC_PAWN_BB(board, side) ^= bit;
@@ -1075,7 +1225,7 @@ int fc_board_make_move (fc_board_t *board, fc_move_t *move)
 {
 	uint64_t b;
 	/* side is the orientation of the pawn (if the move is a pawn) */
-	fc_player_t side, enemy_side;
+	fc_player_t side, enemy_side, seat;
 
 	assert(board && move);
 
@@ -1094,6 +1244,11 @@ int fc_board_make_move (fc_board_t *board, fc_move_t *move)
 	 */
 	FC_BITBOARD(board, move->player, move->piece) ^= move->move;
 	b = FC_BITBOARD(board, move->player, move->piece) & move->move;
+	if (!b) {
+		/* a remove takes the piece off the board */
+		board->material[move->player] -=
+			board->piece_value[move->piece];
+	}
 
 	/*
 	 * NOTE: We are getting the orientation for the enemy pawn here because
@@ -1103,10 +1258,16 @@ int fc_board_make_move (fc_board_t *board, fc_move_t *move)
 	 */
 	enemy_side = fc_get_pawn_orientation(board, b);
 
+	seat = move->player;
 	if (move->piece == FC_PAWN) {
 		side = fc_get_pawn_orientation(board, b ^ move->move);
 		FC_PAWN_BB(board, side) ^= move->move;
+		seat = side;
 	}
+	/* the piece goes from b ^ move->move to b (nowhere for a remove) */
+	board->positional[move->player] +=
+		square_value(board, seat, move->piece, b) -
+		square_value(board, seat, move->piece, b ^ move->move);
 
 	update_enemy_bitboards(board, move, enemy_side, b);
 	update_empty_positions(board);
@@ -1145,7 +1306,12 @@ int fc_board_make_pawn_move (fc_board_t *board, fc_move_t *move,
 		return 0;
 	}
 	FC_BITBOARD(board, move->player, FC_PAWN) ^= pawn;
+	board->material[move->player] += board->piece_value[new_piece] -
+		board->piece_value[FC_PAWN];
 	orientation = fc_get_pawn_orientation(board, pawn);
+	board->positional[move->player] +=
+		square_value(board, move->player, new_piece, pawn) -
+		square_value(board, orientation, FC_PAWN, pawn);
 	FC_PAWN_BB(board, orientation) ^= pawn;
 
 	fc_move_copy(&copy, move);
@@ -1166,6 +1332,37 @@ void fc_board_copy (fc_board_t *dst, fc_board_t *src)
 	for (p = FC_PAWN; p <= FC_KING; p++) {
 		dst->piece_value[p] = src->piece_value[p];
 	}
+	for (i = 0; i < FC_NUM_PLAYERS; i++) {
+		dst->material[i] = src->material[i];
+		dst->positional[i] = src->positional[i];
+	}
+	dst->pst = src->pst;
+}
+
+/* the multipliers of the splitmix64 finalizer; see also FC_LEFT_COL */
+#define HASH_MUL1 ((((uint64_t)0xBF58476D) << 32) | ((uint64_t)0x1CE4E5B9))
+#define HASH_MUL2 ((((uint64_t)0x94D049BB) << 32) | ((uint64_t)0x133111EB))
+
+static uint64_t mix (uint64_t x)
+{
+	x = (x ^ (x >> 30)) * HASH_MUL1;
+	x = (x ^ (x >> 27)) * HASH_MUL2;
+	return x ^ (x >> 31);
+}
+
+/*
+ * The empty spaces are implied by the other bitboards, so they are left out.
+ */
+uint64_t fc_board_hash (fc_board_t *board)
+{
+	int i;
+	uint64_t hash = 0;
+
+	assert(board);
+	for (i = 0; i < FC_EMPTY_SPACES; i++) {
+		hash = mix(hash ^ board->bitb[i]) + i;
+	}
+	return hash;
 }
 
 /*
@@ -1187,35 +1384,39 @@ int fc_board_game_over (fc_board_t *board)
 		fc_board_is_player_out(board, FC_FOURTH)));
 }
 
-static int get_material_score (fc_board_t *board, fc_player_t player)
+int fc_board_score_position (fc_board_t *board, fc_player_t player)
 {
-	int ret = 0;
-	uint64_t piece, pieces;
-	fc_piece_t i;
+	int *material, *positional;
 
-	for (i = FC_PAWN; i <= FC_KING; i++) {
-		pieces = FC_BITBOARD(board, player, i);
-		FC_FOREACH(piece, pieces) {
-			ret += fc_board_get_material_value(board, i);
-		}
-	}
-	return ret;
+	assert(board);
+	material = board->material;
+	positional = board->positional;
+	return (material[player] - material[FC_NEXT_PLAYER(player)] +
+		material[FC_PARTNER(player)] -
+		material[FC_PARTNER(FC_NEXT_PLAYER(player))] +
+		positional[player] - positional[FC_NEXT_PLAYER(player)] +
+		positional[FC_PARTNER(player)] -
+		positional[FC_PARTNER(FC_NEXT_PLAYER(player))]);
 }
 
-int fc_board_score_position (fc_board_t *board, fc_player_t player)
+void fc_board_score_players (fc_board_t *board, int *scores)
 {
-	assert(board);
-	return (get_material_score(board, player) -
-		get_material_score(board, FC_NEXT_PLAYER(player)) +
-		get_material_score(board, FC_PARTNER(player)) -
-		get_material_score(board, FC_PARTNER(FC_NEXT_PLAYER(player))));
+	int *material;
+	fc_player_t p;
+
+	assert(board && scores);
+	material = board->material;
+	for (p = FC_FIRST; p <= FC_FOURTH; p++) {
+		scores[p] = 2 * material[p] + material[FC_PARTNER(p)];
+	}
 }
 
 int fc_board_num_players (fc_board_t *board)
 {
-	return  !!FC_BITBOARD(board, FC_FIRST, FC_KING) +
-		!!FC_BITBOARD(board, FC_SECOND, FC_KING) +
-		!!FC_BITBOARD(board, FC_THIRD, FC_KING) +
-		!!FC_BITBOARD(board, FC_FOURTH, FC_KING);
+	/* each player has one king at most */
+	return fc_popcount(FC_BITBOARD(board, FC_FIRST, FC_KING) |
+			FC_BITBOARD(board, FC_SECOND, FC_KING) |
+			FC_BITBOARD(board, FC_THIRD, FC_KING) |
+			FC_BITBOARD(board, FC_FOURTH, FC_KING));
 }
 
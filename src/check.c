@@ -472,6 +472,12 @@ static int is_check (fc_board_t *board, fc_player_t player)
 		king_in_check_by_knight(board, player, king));
 }
 
+int fc_board_in_check (fc_board_t *board, fc_player_t player)
+{
+	assert(board);
+	return is_check(board, player);
+}
+
 /*
  * Returns FC_CHECK if player's king is in check, FC_CHECKMATE if checkmate,
  * and 0 otherwise.
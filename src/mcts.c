@@ -0,0 +1,466 @@
+/*
+ * LibForchess
+ * Copyright (c) 2011, Jason M Barnes
+ *
+ * This file is subject to the terms and conditions of the 'LICENSE' file
+ * which is a part of this source code package.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* needed for clock_gettime() and the pthreads API under -std=c89 */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "forchess/ai.h"
+#include "forchess/board.h"
+#include "forchess/moves.h"
+
+/* the number of nodes preallocated for the search tree */
+#define POOL_SIZE (1 << 18)
+
+/* the number of playouts to run when neither budget has been set */
+#define DEFAULT_PLAYOUTS 10000
+
+/* a node must have been visited this many times before it is expanded */
+#define EXPAND_VISITS 1
+
+/* the exploration constant of the UCT formula */
+#define UCT_C 0.7
+
+/* the longest path followed from the root of the tree */
+#define MAX_PATH 256
+
+/*
+ * A node of the search tree.  The children of a node are allocated
+ * contiguously from the node pool, so the node only needs to know where the
+ * first one is and how many there are.  The wins are from the point of view
+ * of the team which made the move into the node.
+ */
+typedef struct {
+	fc_move_t move;
+	fc_player_t player; /* the player to move at this node */
+	int children;
+	int nchildren;
+	int expanded;
+	int visits;
+	int virtual_loss;
+	double wins;
+} node_t;
+
+typedef struct {
+	fc_ai_t *ai;
+	fc_mlist_t *given;
+	node_t *pool;
+	int used;
+	unsigned long playouts;
+	unsigned long max_playouts;
+	long deadline; /* in milliseconds; 0 if there is none */
+	int plies; /* the length of a playout */
+	pthread_mutex_t lock;
+} tree_t;
+
+typedef struct {
+	tree_t *tree;
+	fc_board_t board;
+	fc_mlist_t list;
+	uint64_t random;
+	pthread_t thread;
+} worker_t;
+
+static long now_in_ms (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/* the constants of the random number generator; see also FC_LEFT_COL */
+#define MULTIPLIER ((((uint64_t)0x2545F491) << 32) | ((uint64_t)0x4F6CDD1D))
+#define SEED ((((uint64_t)0x9E3779B9) << 32) | ((uint64_t)0x7F4A7C15))
+
+/*
+ * A xorshift64* generator.  Each worker has its own state so the playouts do
+ * not contend for a shared one.
+ */
+static uint32_t next_random (uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return (uint32_t)((x * MULTIPLIER) >> 32);
+}
+
+/*
+ * Returns the next player after player who is still in the game.
+ */
+static fc_player_t next_player (fc_board_t *board, fc_player_t player)
+{
+	int i;
+
+	for (i = 0; i < FC_NUM_PLAYERS; i++) {
+		player = FC_NEXT_PLAYER(player);
+		if (!fc_board_is_player_out(board, player)) {
+			break;
+		}
+	}
+	return player;
+}
+
+/*
+ * The tree and the playouts never branch on the promotion piece; a pawn is
+ * always promoted to a queen.
+ */
+static void make_move (fc_board_t *board, fc_move_t *move)
+{
+	if (!fc_board_make_move(board, move)) {
+		fc_board_make_pawn_move(board, move, FC_QUEEN);
+	}
+}
+
+/*
+ * Returns the result of the playout for the team of FC_FIRST and FC_THIRD
+ * between 0 (loss) and 1 (win).  Unfinished games are scored by passing the
+ * material difference through a logistic curve.
+ */
+static double first_team_result (fc_board_t *board)
+{
+	double scale;
+
+	if (fc_board_game_over(board)) {
+		return (fc_board_is_player_out(board, FC_FIRST) &&
+			fc_board_is_player_out(board, FC_THIRD)) ? 0.0 : 1.0;
+	}
+
+	scale = 4.0 * fc_board_get_material_value(board, FC_PAWN);
+	if (scale < 1.0) {
+		scale = 1.0;
+	}
+	return 1.0 / (1.0 + exp(-fc_board_score_position(board, FC_FIRST) /
+				scale));
+}
+
+/*
+ * The light playout policy:  Capture a king whenever possible; otherwise,
+ * play a random pseudo-legal move.  The list is sorted by the quick ranking
+ * of the moves, so a king capture will be first if there is one.
+ */
+static fc_move_t *choose_playout_move (worker_t *w)
+{
+	fc_move_t *move;
+
+	move = fc_mlist_get(&w->list, 0);
+	if (move->opp_piece == FC_KING && move->opp_player != FC_NONE) {
+		return move;
+	}
+	return fc_mlist_get(&w->list,
+			next_random(&w->random) % fc_mlist_length(&w->list));
+}
+
+static double playout (worker_t *w, fc_player_t player)
+{
+	int i;
+	fc_board_t *board = &w->board;
+
+	for (i = 0; i < w->tree->plies && !fc_board_game_over(board); i++) {
+		if (fc_board_is_player_out(board, player)) {
+			player = next_player(board, player);
+		}
+		fc_mlist_clear(&w->list);
+		fc_board_get_all_moves(board, &w->list, player);
+		if (fc_mlist_length(&w->list)) {
+			make_move(board, choose_playout_move(w));
+		}
+		player = next_player(board, player);
+	}
+
+	return first_team_result(board);
+}
+
+/*
+ * Creates the children of node.  The root's children are the legal moves (or
+ * the given moves); every other node uses the cheaper pseudo-legal moves.  If
+ * the pool is exhausted, the node stays a leaf for the rest of the search.
+ */
+static void expand (tree_t *tree, node_t *node, worker_t *w)
+{
+	int i, n;
+	node_t *child;
+	fc_move_t *move;
+	fc_player_t side;
+
+	node->expanded = 1;
+	fc_mlist_clear(&w->list);
+	if (node != tree->pool) {
+		fc_board_get_all_moves(&w->board, &w->list, node->player);
+	}
+	if (fc_mlist_length(&w->list) == 0) {
+		if (node == tree->pool && tree->given) {
+			fc_mlist_copy(&w->list, tree->given);
+		} else {
+			fc_board_get_moves(&w->board, &w->list, node->player);
+		}
+	}
+
+	n = fc_mlist_length(&w->list);
+	if (tree->used + n > POOL_SIZE) {
+		return;
+	}
+	node->children = tree->used;
+	node->nchildren = n;
+	tree->used += n;
+	for (i = 0; i < n; i++) {
+		child = tree->pool + node->children + i;
+		move = fc_mlist_get(&w->list, i);
+		fc_move_copy(&child->move, move);
+		if (move->promote == FC_NONE &&
+		    fc_board_move_requires_promotion(&w->board, move,
+				&side)) {
+			child->move.promote = FC_QUEEN;
+		}
+		child->player = FC_NONE;
+		child->children = 0;
+		child->nchildren = 0;
+		child->expanded = 0;
+		child->visits = 0;
+		child->virtual_loss = 0;
+		child->wins = 0.0;
+	}
+}
+
+/*
+ * Selects the child with the highest upper confidence bound.  Unvisited
+ * children are selected first.  Virtual losses count as visits without any
+ * wins, which steers concurrent workers down different paths.
+ */
+static node_t *select_child (tree_t *tree, node_t *node)
+{
+	int i, n;
+	double value, best, log_n;
+	node_t *child, *ret = NULL;
+
+	best = -1.0;
+	log_n = log(node->visits + node->virtual_loss + 1.0);
+	for (i = 0; i < node->nchildren; i++) {
+		child = tree->pool + node->children + i;
+		n = child->visits + child->virtual_loss;
+		if (n == 0) {
+			return child;
+		}
+		value = child->wins / n + UCT_C * sqrt(log_n / n);
+		if (value > best) {
+			best = value;
+			ret = child;
+		}
+	}
+	return ret;
+}
+
+static int budget_spent (tree_t *tree)
+{
+	if (tree->max_playouts && tree->playouts >= tree->max_playouts) {
+		return 1;
+	}
+	if (tree->deadline && now_in_ms() >= tree->deadline) {
+		return 1;
+	}
+	if (tree->ai->thread && fc_ai_thread_stopping(tree->ai->thread)) {
+		return 1;
+	}
+	return tree->ai->timeout && time(NULL) >= tree->ai->timeout;
+}
+
+/*
+ * Runs one iteration of the search:  selection and expansion under the tree
+ * lock, the playout without it, then backpropagation under the lock again.
+ * Returns 0 once the budget has been spent.
+ */
+static int iterate (worker_t *w)
+{
+	int i, n, expanded;
+	double result;
+	node_t *path[MAX_PATH], *node;
+	tree_t *tree = w->tree;
+
+	pthread_mutex_lock(&tree->lock);
+	if (budget_spent(tree)) {
+		pthread_mutex_unlock(&tree->lock);
+		return 0;
+	}
+	tree->playouts++;
+
+	fc_board_copy(&w->board, tree->ai->board);
+	node = tree->pool;
+	node->virtual_loss++;
+	path[0] = node;
+	n = 1;
+	while (n < MAX_PATH && !fc_board_game_over(&w->board)) {
+		expanded = 0;
+		if (!node->expanded && (node == tree->pool ||
+					node->visits >= EXPAND_VISITS)) {
+			expand(tree, node, w);
+			expanded = 1;
+		}
+		if (node->nchildren == 0) {
+			break;
+		}
+		node = select_child(tree, node);
+		make_move(&w->board, &node->move);
+		if (node->player == FC_NONE) {
+			node->player = next_player(&w->board,
+					node->move.player);
+		}
+		node->virtual_loss++;
+		path[n++] = node;
+		if (expanded) {
+			break;
+		}
+	}
+	pthread_mutex_unlock(&tree->lock);
+
+	result = playout(w, node->player);
+
+	pthread_mutex_lock(&tree->lock);
+	for (i = 0; i < n; i++) {
+		path[i]->virtual_loss--;
+		path[i]->visits++;
+		if (i > 0) {
+			path[i]->wins += (path[i]->move.player % 2 == 0) ?
+				result : 1.0 - result;
+		}
+	}
+	pthread_mutex_unlock(&tree->lock);
+
+	return 1;
+}
+
+static void *run_worker (void *arg)
+{
+	worker_t *w = arg;
+
+	while (iterate(w))
+		;
+	return NULL;
+}
+
+/*
+ * Follows the most visited children from the root to build the principal
+ * variation.
+ */
+static void save_pv (tree_t *tree)
+{
+	int i;
+	node_t *node, *child, *best;
+	fc_ai_t *ai = tree->ai;
+
+	ai->pv_length = 0;
+	node = tree->pool;
+	while (ai->pv_length < FC_AI_MAX_PV) {
+		best = NULL;
+		for (i = 0; i < node->nchildren; i++) {
+			child = tree->pool + node->children + i;
+			if (child->visits && (!best ||
+					child->visits > best->visits)) {
+				best = child;
+			}
+		}
+		if (!best) {
+			break;
+		}
+		fc_move_copy(&(ai->pv[ai->pv_length++]), &best->move);
+		node = best;
+	}
+	fc_board_copy(&(ai->pv_board), ai->board);
+}
+
+int fc_ai_mcts (fc_ai_t *ai, fc_mlist_t *ret, fc_mlist_t *given,
+		fc_player_t player, int depth)
+{
+	int i, nthreads, nworkers;
+	tree_t tree;
+	worker_t *workers;
+	node_t *child;
+
+	tree.pool = malloc(POOL_SIZE * sizeof(node_t));
+	nthreads = (ai->threads > 1) ? ai->threads : 1;
+	workers = calloc(nthreads, sizeof(worker_t));
+	if (!tree.pool || !workers) {
+		free(tree.pool);
+		free(workers);
+		return 0;
+	}
+
+	tree.ai = ai;
+	tree.given = given;
+	tree.used = 1;
+	tree.playouts = 0;
+	tree.max_playouts = ai->playouts;
+	tree.deadline = (ai->msecs) ? now_in_ms() + (long)ai->msecs : 0;
+	if (!tree.max_playouts && !tree.deadline && !ai->timeout) {
+		tree.max_playouts = DEFAULT_PLAYOUTS;
+	}
+	tree.plies = depth;
+	pthread_mutex_init(&tree.lock, NULL);
+
+	tree.pool->player = player;
+	tree.pool->children = 0;
+	tree.pool->nchildren = 0;
+	tree.pool->expanded = 0;
+	tree.pool->visits = 0;
+	tree.pool->virtual_loss = 0;
+	tree.pool->wins = 0.0;
+
+	/* the calling thread is the first worker */
+	for (i = 0; i < nthreads; i++) {
+		workers[i].tree = &tree;
+		workers[i].random = SEED * (i + 1);
+		fc_mlist_init(&workers[i].list);
+	}
+	for (i = 1; i < nthreads; i++) {
+		if (pthread_create(&workers[i].thread, NULL, run_worker,
+					&workers[i])) {
+			break;
+		}
+	}
+	nworkers = i;
+	run_worker(&workers[0]);
+	for (i = 1; i < nworkers; i++) {
+		pthread_join(workers[i].thread, NULL);
+	}
+
+	/* rank the root moves by the number of times they were visited */
+	for (i = 0; i < tree.pool->nchildren; i++) {
+		child = tree.pool + tree.pool->children + i;
+		fc_mlist_insert(ret, &child->move, child->visits);
+	}
+	save_pv(&tree);
+
+	for (i = 0; i < nthreads; i++) {
+		fc_mlist_free(&workers[i].list);
+	}
+	pthread_mutex_destroy(&tree.lock);
+	free(workers);
+	free(tree.pool);
+
+	return fc_mlist_length(ret) > 0;
+}
@@ -52,6 +52,15 @@ void fc_move_set_promotion (fc_move_t *move, fc_piece_t promote)
 	move->promote = promote;
 }
 
+/*
+ * A remove is the only move with a single bit set.
+ */
+int fc_move_is_reversible (fc_move_t *move)
+{
+	return (move->piece != FC_PAWN && move->opp_piece == FC_NONE &&
+		(move->move & (move->move - 1)) != 0);
+}
+
 /*
  * This must be called before the insert, copy, and merge functions can be
  * used.
@@ -87,16 +96,23 @@ int fc_mlist_copy (fc_mlist_t *dst, fc_mlist_t *src)
  * (5, 3, 2, 4, 1) would become (5, 4, 3, 2, 1).
  */
 int fc_mlist_insert (fc_mlist_t *list, fc_move_t *move, int32_t value)
+{
+	return fc_mlist_insert_from(list, 0, move, value);
+}
+
+int fc_mlist_insert_from (fc_mlist_t *list, int index, fc_move_t *move,
+		int32_t value)
 {
 	uint32_t i;
 	fc_move_t *old;
 
 	assert(list->index + 1 <= FC_DEFAULT_MLIST_SIZE);
+	assert(index >= 0 && (uint32_t)index <= list->index);
 
 	/*
 	 * TODO binary search might be faster
 	 */
-	for (i = 0; i < list->index; i++) {
+	for (i = index; i < list->index; i++) {
 		old = list->moves + i;
 		if (value > old->value) {
 			break;
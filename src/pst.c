@@ -0,0 +1,208 @@
+/*
+ * LibForchess
+ * Copyright (c) 2011, Jason M Barnes
+ *
+ * This file is subject to the terms and conditions of the 'LICENSE' file
+ * which is a part of this source code package.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Piece-square tables.  The built-in tables and the ones read from a file are
+ * written from the first player's seat, and are turned a quarter of the board
+ * at a time for the others.  The board keeps the running sums (see
+ * fc_board_set_pst()).
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <strings.h>
+
+#include "forchess/board.h"
+
+/*
+ * The built-in tables, as seen from the first player's seat:  rank 8 on top
+ * and the a-file on the left, with the first player's corner at a1.  A
+ * player's pieces start out along both edges of his corner, so each table is
+ * the same on either side of the a1-h8 diagonal.
+ */
+static const int default_tables[FC_NUM_PIECES][64] = {
+	{	/* pawns */
+		  0,   0,   0,   0,   0,   0,   0,   0,
+		 20,  20,  20,  20,  20,  20,  20,   0,
+		 10,  10,  10,  10,  10,  10,  20,   0,
+		  5,   5,   5,   5,   5,  10,  20,   0,
+		  0,   0,   0,   0,   5,  10,  20,   0,
+		  0,   0,   0,   0,   5,  10,  20,   0,
+		  0,   0,   0,   0,   5,  10,  20,   0,
+		  0,   0,   0,   0,   5,  10,  20,   0
+	},
+	{	/* bishops */
+		-20, -10,  -5,   0,   0,  -5, -10, -20,
+		-10,  -5,   0,   5,   5,   0,  -5, -10,
+		 -5,   0,   5,  10,  10,   5,   0,  -5,
+		  0,   5,  10,  10,  10,  10,   5,   0,
+		  0,   5,  10,  10,  10,  10,   5,   0,
+		 -5,   0,   5,  10,  10,   5,   0,  -5,
+		-10,  -5,   0,   5,   5,   0,  -5, -10,
+		-20, -10,  -5,   0,   0,  -5, -10, -20
+	},
+	{	/* knights */
+		-40, -25, -10,   0,   0, -10, -25, -40,
+		-25, -10,   0,  10,  10,   0, -10, -25,
+		-10,   0,  10,  15,  15,  10,   0, -10,
+		  0,  10,  15,  20,  20,  15,  10,   0,
+		  0,  10,  15,  20,  20,  15,  10,   0,
+		-10,   0,  10,  15,  15,  10,   0, -10,
+		-25, -10,   0,  10,  10,   0, -10, -25,
+		-40, -25, -10,   0,   0, -10, -25, -40
+	},
+	{	/* rooks */
+		 -5,   0,   0,   0,   0,   0,   0,  -5,
+		  0,   0,   0,   5,   5,   0,   0,   0,
+		  0,   0,   5,   5,   5,   5,   0,   0,
+		  0,   5,   5,   5,   5,   5,   5,   0,
+		  0,   5,   5,   5,   5,   5,   5,   0,
+		  0,   0,   5,   5,   5,   5,   0,   0,
+		  0,   0,   0,   5,   5,   0,   0,   0,
+		 -5,   0,   0,   0,   0,   0,   0,  -5
+	},
+	{	/* queens */
+		-20, -10,  -5,   0,   0,  -5, -10, -20,
+		-10,  -5,   0,   5,   5,   0,  -5, -10,
+		 -5,   0,   5,   5,   5,   5,   0,  -5,
+		  0,   5,   5,   5,   5,   5,   5,   0,
+		  0,   5,   5,   5,   5,   5,   5,   0,
+		 -5,   0,   5,   5,   5,   5,   0,  -5,
+		-10,  -5,   0,   5,   5,   0,  -5, -10,
+		-20, -10,  -5,   0,   0,  -5, -10, -20
+	},
+	{	/* kings */
+		-50, -50, -50, -50, -50, -50, -50, -50,
+		-40, -40, -40, -40, -40, -40, -40, -50,
+		-30, -30, -30, -30, -30, -30, -40, -50,
+		-20, -20, -20, -20, -20, -30, -40, -50,
+		-10, -10, -10, -10, -20, -30, -40, -50,
+		  0,   0,   0, -10, -20, -30, -40, -50,
+		 15,  15,   0, -10, -20, -30, -40, -50,
+		 20,  15,   0, -10, -20, -30, -40, -50
+	}
+};
+
+/*
+ * Returns the square that sq, as seen from the first player's seat, is from
+ * the given seat.  The seats go clockwise from a1 to a8, h8 and h1.
+ */
+static int rotate (fc_player_t seat, int sq)
+{
+	int row = sq / 8, col = sq % 8;
+
+	switch (seat) {
+	case FC_SECOND:
+		return (7 - col) * 8 + row;
+	case FC_THIRD:
+		return (7 - row) * 8 + (7 - col);
+	case FC_FOURTH:
+		return col * 8 + (7 - row);
+	default:
+		return sq;
+	}
+}
+
+void fc_pst_rotate (fc_pst_t *pst)
+{
+	int sq;
+	fc_piece_t piece;
+	fc_player_t seat;
+
+	assert(pst);
+	for (seat = FC_FIRST; seat <= FC_FOURTH; seat++) {
+		for (piece = FC_PAWN; piece <= FC_KING; piece++) {
+			for (sq = 0; sq < 64; sq++) {
+				pst->value[seat][piece][rotate(seat, sq)] =
+					pst->square[piece][sq];
+			}
+		}
+	}
+}
+
+void fc_pst_init (fc_pst_t *pst)
+{
+	int sq;
+	fc_piece_t piece;
+
+	assert(pst);
+	/* the tables above have rank 8 first */
+	for (piece = FC_PAWN; piece <= FC_KING; piece++) {
+		for (sq = 0; sq < 64; sq++) {
+			pst->square[piece][(7 - sq / 8) * 8 + sq % 8] =
+				default_tables[piece][sq];
+		}
+	}
+	fc_pst_rotate(pst);
+}
+
+/*
+ * See fc_board_setup() for the piece codes.
+ */
+int fc_pst_load (fc_pst_t *pst, const char *filename)
+{
+	FILE *fp;
+	int i, read;
+	char code;
+	fc_piece_t piece;
+
+	assert(pst && filename);
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		return 0;
+	}
+
+	bzero(pst->square, sizeof(pst->square));
+	read = fscanf(fp, " %c", &code);
+	while (read != EOF) {
+		switch (code) {
+		case 'P':
+			piece = FC_PAWN; break;
+		case 'B':
+			piece = FC_BISHOP; break;
+		case 'N':
+			piece = FC_KNIGHT; break;
+		case 'R':
+			piece = FC_ROOK; break;
+		case 'Q':
+			piece = FC_QUEEN; break;
+		case 'K':
+			piece = FC_KING; break;
+		default:
+			fclose(fp);
+			return 0;
+		}
+
+		for (i = 0; i < 64; i++) {
+			if (fscanf(fp, "%d",
+					&(pst->square[piece][(7 - i / 8) * 8 +
+					i % 8])) != 1) {
+				fclose(fp);
+				return 0;
+			}
+		}
+		read = fscanf(fp, " %c", &code);
+	}
+	fclose(fp);
+	fc_pst_rotate(pst);
+	return 1;
+}
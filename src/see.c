@@ -0,0 +1,225 @@
+/*
+ * LibForchess
+ * Copyright (c) 2011, Jason M Barnes
+ *
+ * This file is subject to the terms and conditions of the 'LICENSE' file
+ * which is a part of this source code package.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Static exchange evaluation.  Plays out the sequence of captures on a single
+ * square without searching any other moves.
+ */
+
+#include <assert.h>
+
+#include "forchess/board.h"
+
+/* the longest exchange possible:  every piece on the board takes part */
+#define MAX_EXCHANGE 64
+
+/*
+ * Returns the squares attacked from sq by a slider moving shift bits at a
+ * time, up to and including the first occupied square.  The slide stops once
+ * it reaches a square on the edge column.
+ */
+static uint64_t slide (uint64_t sq, int shift, int up, uint64_t edge,
+		uint64_t occupied)
+{
+	uint64_t i, ret = 0;
+
+	for (i = sq; i && !(i & edge); ) {
+		i = (up) ? i << shift : i >> shift;
+		ret |= i;
+		if (i & occupied) {
+			break;
+		}
+	}
+	return ret;
+}
+
+static uint64_t lateral_attacks (uint64_t sq, uint64_t occupied)
+{
+	return (slide(sq, 8, 1, 0, occupied) |
+		slide(sq, 8, 0, 0, occupied) |
+		slide(sq, 1, 0, FC_LEFT_COL, occupied) |
+		slide(sq, 1, 1, FC_RIGHT_COL, occupied));
+}
+
+static uint64_t diagonal_attacks (uint64_t sq, uint64_t occupied)
+{
+	return (slide(sq, 7, 1, FC_LEFT_COL, occupied) |
+		slide(sq, 9, 0, FC_LEFT_COL, occupied) |
+		slide(sq, 9, 1, FC_RIGHT_COL, occupied) |
+		slide(sq, 7, 0, FC_RIGHT_COL, occupied));
+}
+
+static uint64_t knight_attacks (uint64_t sq)
+{
+	uint64_t ret = 0;
+
+	if (!(sq & FC_LEFT_COL)) {
+		ret |= (sq << 15) | (sq >> 17);
+		if (!(sq & FC_2LEFT_COL)) {
+			ret |= (sq << 6) | (sq >> 10);
+		}
+	}
+	if (!(sq & FC_RIGHT_COL)) {
+		ret |= (sq << 17) | (sq >> 15);
+		if (!(sq & FC_2RIGHT_COL)) {
+			ret |= (sq << 10) | (sq >> 6);
+		}
+	}
+	return ret;
+}
+
+static uint64_t king_attacks (uint64_t sq)
+{
+	uint64_t ret;
+
+	ret = (sq << 8) | (sq >> 8);
+	if (!(sq & FC_LEFT_COL)) {
+		ret |= (sq << 7) | (sq >> 9) | (sq >> 1);
+	}
+	if (!(sq & FC_RIGHT_COL)) {
+		ret |= (sq << 9) | (sq >> 7) | (sq << 1);
+	}
+	return ret;
+}
+
+/*
+ * Returns the pawns, of any player, which could capture on sq.  The direction
+ * in which a pawn captures depends on its orientation rather than on the
+ * player who owns it.
+ */
+static uint64_t pawn_attacks (fc_board_t *board, uint64_t sq)
+{
+	uint64_t left, right;
+
+	left = (sq & FC_LEFT_COL) ? 0 : sq >> 1;
+	right = (sq & FC_RIGHT_COL) ? 0 : sq << 1;
+	return ((FC_PAWN_BB(board, FC_FIRST) & ((sq >> 8) | left)) |
+		(FC_PAWN_BB(board, FC_SECOND) & ((sq << 8) | left)) |
+		(FC_PAWN_BB(board, FC_THIRD) & ((sq << 8) | right)) |
+		(FC_PAWN_BB(board, FC_FOURTH) & ((sq >> 8) | right)));
+}
+
+/*
+ * Finds player's least valuable piece which attacks sq.  Returns the bit of
+ * the piece (or 0 if there is none) and sets type to the kind of piece.  The
+ * diagonal and lateral parameters are the squares that a bishop and a rook on
+ * sq would attack.
+ */
+static uint64_t least_valuable_attacker (fc_board_t *board,
+		fc_player_t player, uint64_t sq, uint64_t occupied,
+		uint64_t diagonal, uint64_t lateral, fc_piece_t *type)
+{
+	uint64_t attackers;
+	fc_piece_t piece;
+
+	for (piece = FC_PAWN; piece <= FC_KING; piece++) {
+		attackers = FC_BITBOARD(board, player, piece) & occupied;
+		switch (piece) {
+		case FC_PAWN:
+			attackers &= pawn_attacks(board, sq);
+			break;
+		case FC_BISHOP:
+			attackers &= diagonal;
+			break;
+		case FC_KNIGHT:
+			attackers &= knight_attacks(sq);
+			break;
+		case FC_ROOK:
+			attackers &= lateral;
+			break;
+		case FC_QUEEN:
+			attackers &= diagonal | lateral;
+			break;
+		case FC_KING:
+			attackers &= king_attacks(sq);
+			break;
+		}
+		if (attackers) {
+			*type = piece;
+			return attackers & (~attackers + 1);
+		}
+	}
+	return 0;
+}
+
+/*
+ * The exchange alternates between the teams, since no one may capture a piece
+ * of his own team.  After a capture, the other team's players get their chance
+ * to recapture in turn order:  first the next player, then the player across
+ * from him.  The partner of the capturer moves in between, but he cannot
+ * capture on the square.
+ *
+ * gain[d] is the material won by the team that makes the d'th capture,
+ * assuming that the other team recaptures.  Either team may stop the exchange
+ * at any point, which is resolved from the end of the list back to the start.
+ */
+int fc_board_see (fc_board_t *board, fc_move_t *move)
+{
+	int d, i, gain[MAX_EXCHANGE];
+	uint64_t from, sq, attacker, occupied, diagonal, lateral;
+	fc_piece_t on_square, type;
+	fc_player_t mover, p;
+
+	assert(board && move);
+	from = move->move & FC_BITBOARD(board, move->player, move->piece);
+	sq = move->move ^ from;
+	if (!from || !sq) {
+		return 0;
+	}
+
+	gain[0] = (move->opp_piece == FC_NONE) ? 0 :
+		fc_board_get_material_value(board, move->opp_piece);
+	on_square = move->piece;
+	if (move->promote != FC_NONE) {
+		gain[0] += fc_board_get_material_value(board, move->promote) -
+			fc_board_get_material_value(board, FC_PAWN);
+		on_square = move->promote;
+	}
+	occupied = ~board->bitb[FC_EMPTY_SPACES] ^ from;
+	mover = move->player;
+
+	for (d = 1; d < MAX_EXCHANGE; d++) {
+		attacker = 0;
+		diagonal = diagonal_attacks(sq, occupied);
+		lateral = lateral_attacks(sq, occupied);
+		for (i = 1; i <= 3 && !attacker; i += 2) {
+			p = (mover + i) % FC_NUM_PLAYERS;
+			attacker = least_valuable_attacker(board, p, sq,
+					occupied, diagonal, lateral, &type);
+		}
+		if (!attacker) {
+			break;
+		}
+
+		gain[d] = fc_board_get_material_value(board, on_square) -
+			gain[d - 1];
+		occupied ^= attacker;
+		on_square = type;
+		mover = p;
+	}
+
+	while (--d) {
+		if (-gain[d] < gain[d - 1]) {
+			gain[d - 1] = -gain[d];
+		}
+	}
+	return gain[0];
+}
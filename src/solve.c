@@ -0,0 +1,417 @@
+/*
+ * LibForchess
+ * Copyright (c) 2011, Jason M Barnes
+ *
+ * This file is subject to the terms and conditions of the 'LICENSE' file
+ * which is a part of this source code package.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A depth-first proof-number (df-pn) solver.  The nodes at which our team is
+ * to move are OR nodes:  one winning move proves them.  The nodes at which the
+ * opponents are to move are AND nodes:  every reply must lose.  The proof and
+ * disproof numbers of the nodes are kept in a transposition table of a fixed
+ * size rather than in an explicit tree.
+ *
+ * A repetition is not a win, so a node on the search path counts as disproven
+ * when it is reached again.  That disproof holds for the path and not for the
+ * node, so whatever is disproven through it is marked as such; a root that is
+ * only disproven that way is reported as unknown rather than disproven.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "forchess/ai.h"
+#include "forchess/board.h"
+#include "forchess/moves.h"
+
+#define INFINITE_PN ((uint32_t)0x7fffffff)
+
+/* the number of consecutive slots searched for an entry in the table */
+#define PROBES 4
+
+/* the size of the table if no memory budget is given */
+#define DEFAULT_MEMORY (16 * 1024 * 1024)
+
+/*
+ * How many times over the table may be refilled by replacing entries.  A table
+ * too small for the search loses what it learns as fast as it learns it, and
+ * can cycle through the same nodes forever.
+ */
+#define MAX_TURNOVER 64
+
+/* the fewest entries in the table:  enough for a whole search path to sit in
+ * the table alongside the slots that it probes */
+#define MIN_ENTRIES (PROBES * FC_SOLVE_MAX_PLIES)
+
+/* how a move ended up before the child node was searched */
+#define OPEN 0
+#define WON 1
+#define LOST 2
+
+typedef struct {
+	uint64_t key; /* 0 if the slot is empty */
+	uint32_t pn;
+	uint32_t dn;
+	uint32_t work; /* nodes expanded to get pn and dn; used for replacement */
+	int on_path; /* the node is on the current search path */
+	int path_dependent; /* dn is 0 only because of a repetition */
+} entry_t;
+
+typedef struct {
+	entry_t *table;
+	unsigned long size; /* a power of two */
+	unsigned long nodes;
+	unsigned long node_limit;
+	unsigned long replaced; /* entries that have been replaced */
+	fc_player_t player; /* the player we are solving for */
+	int aborted; /* a node could not be stored or memory ran out */
+	fc_mlist_t lists[FC_SOLVE_MAX_PLIES];
+} solver_t;
+
+static uint32_t add (uint32_t a, uint32_t b)
+{
+	return (a >= INFINITE_PN - b) ? INFINITE_PN : a + b;
+}
+
+static int same_team (fc_player_t a, fc_player_t b)
+{
+	return a == b || a == FC_PARTNER(b);
+}
+
+/*
+ * Returns the next player after player who is still in the game.
+ */
+static fc_player_t next_player (fc_board_t *board, fc_player_t player)
+{
+	int i;
+
+	for (i = 0; i < FC_NUM_PLAYERS; i++) {
+		player = FC_NEXT_PLAYER(player);
+		if (!fc_board_is_player_out(board, player)) {
+			break;
+		}
+	}
+	return player;
+}
+
+static entry_t *lookup (solver_t *s, uint64_t key)
+{
+	int i;
+	entry_t *e;
+
+	for (i = 0; i < PROBES; i++) {
+		e = s->table + ((key + i) & (s->size - 1));
+		if (e->key == key) {
+			return e;
+		}
+		if (e->key == 0) {
+			break;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Returns the slot for key.  If the key is not in the table, an empty slot is
+ * used or else the slot with the least work behind it is replaced.  Nodes on
+ * the current path are never replaced.  Returns NULL if there is no slot, or
+ * if the table has been turned over too often (see MAX_TURNOVER).
+ */
+static entry_t *store (solver_t *s, uint64_t key)
+{
+	int i;
+	entry_t *e, *victim = NULL;
+
+	for (i = 0; i < PROBES; i++) {
+		e = s->table + ((key + i) & (s->size - 1));
+		if (e->key == key) {
+			return e;
+		}
+		if (e->key == 0) {
+			victim = e;
+			break;
+		}
+		if (!e->on_path && (!victim || e->work < victim->work)) {
+			victim = e;
+		}
+	}
+	if (victim && victim->key && ++s->replaced > s->size * MAX_TURNOVER) {
+		victim = NULL;
+	}
+	if (victim) {
+		victim->key = key;
+		victim->pn = 1;
+		victim->dn = 1;
+		victim->work = 0;
+		victim->on_path = 0;
+		victim->path_dependent = 0;
+	}
+	return victim;
+}
+
+/*
+ * Looks up the proof and disproof numbers of a child node.  A node that is
+ * already on the search path is a repetition, which is not a win.  Sets
+ * path_dependent if the child's disproof rests on a repetition.
+ */
+static void child_numbers (solver_t *s, uint64_t key, int result,
+		uint32_t *pn, uint32_t *dn, int *path_dependent)
+{
+	entry_t *e;
+
+	*path_dependent = 0;
+	if (result == WON) {
+		*pn = 0;
+		*dn = INFINITE_PN;
+	} else if (result == LOST) {
+		*pn = INFINITE_PN;
+		*dn = 0;
+	} else if ((e = lookup(s, key)) != NULL) {
+		*pn = (e->on_path) ? INFINITE_PN : e->pn;
+		*dn = (e->on_path) ? 0 : e->dn;
+		*path_dependent = e->on_path || e->path_dependent;
+	} else {
+		*pn = 1;
+		*dn = 1;
+	}
+}
+
+/*
+ * Decides the nodes which need no search:  finished games and the nodes at
+ * the search horizon, which count as not won.
+ */
+static int classify (solver_t *s, fc_board_t *board, int ply)
+{
+	if (fc_board_game_over(board)) {
+		return (fc_board_is_player_out(board, s->player) &&
+			fc_board_is_player_out(board, FC_PARTNER(s->player))) ?
+			LOST : WON;
+	}
+	return (ply >= FC_SOLVE_MAX_PLIES) ? LOST : OPEN;
+}
+
+/*
+ * Generates the moves for the node.  A player without any move passes, which
+ * is represented by a list without moves and a single child.  Returns 0 and
+ * aborts the search if there is no memory for the children.
+ */
+static int expand (solver_t *s, fc_board_t *board, fc_player_t to_move,
+		int ply, uint64_t **keys, int **results)
+{
+	int i, n;
+	fc_board_t child;
+	fc_mlist_t *list = &(s->lists[ply]);
+
+	fc_mlist_clear(list);
+	fc_board_get_moves(board, list, to_move);
+	n = fc_mlist_length(list);
+	*keys = malloc(((n) ? n : 1) * sizeof(uint64_t));
+	*results = malloc(((n) ? n : 1) * sizeof(int));
+	if (!*keys || !*results) {
+		free(*keys);
+		free(*results);
+		*keys = NULL;
+		*results = NULL;
+		s->aborted = 1;
+		return 0;
+	}
+	if (n == 0) {
+		(*keys)[0] = fc_ai_node_key(board, next_player(board, to_move));
+		(*results)[0] = classify(s, board, ply + 1);
+		return 1;
+	}
+	for (i = 0; i < n; i++) {
+		fc_board_copy(&child, board);
+		fc_board_make_move(&child, fc_mlist_get(list, i));
+		(*keys)[i] = fc_ai_node_key(&child, next_player(&child, to_move));
+		(*results)[i] = classify(s, &child, ply + 1);
+	}
+	return n;
+}
+
+/*
+ * The multiple iterative deepening step of df-pn:  searches the node until its
+ * proof number reaches thpn or its disproof number reaches thdn.
+ */
+static void mid (solver_t *s, fc_board_t *board, fc_player_t to_move,
+		uint64_t key, int ply, uint32_t thpn, uint32_t thdn)
+{
+	int i, n, best, or_node, cpd, pd;
+	int *results;
+	unsigned long start;
+	uint32_t pn, dn, cpn, cdn, second, best_pn, best_dn;
+	uint32_t child_thpn, child_thdn;
+	uint64_t *keys;
+	fc_board_t child;
+	fc_mlist_t *list;
+	entry_t *e;
+
+	start = s->nodes++;
+	or_node = same_team(to_move, s->player);
+	list = &(s->lists[ply]);
+	n = expand(s, board, to_move, ply, &keys, &results);
+	if ((e = store(s, key)) != NULL) {
+		e->on_path = 1;
+	} else {
+		/* without an entry, the node's numbers would never change
+		 * and its parent would pick it again forever */
+		s->aborted = 1;
+	}
+	if (s->aborted) {
+		free(keys);
+		free(results);
+		return;
+	}
+
+	for (;;) {
+		pn = (or_node) ? INFINITE_PN : 0;
+		dn = (or_node) ? 0 : INFINITE_PN;
+		best = 0;
+		best_pn = best_dn = second = INFINITE_PN;
+		/* an OR node's disproof rests on a repetition if any child's
+		 * does; an AND node's only if every disproven child's does */
+		pd = !or_node;
+		for (i = 0; i < n; i++) {
+			child_numbers(s, keys[i], results[i], &cpn, &cdn,
+					&cpd);
+			if (cdn == 0) {
+				pd = (or_node) ? pd || cpd : pd && cpd;
+			}
+			if (or_node) {
+				dn = add(dn, cdn);
+				if (cpn < pn) {
+					second = pn;
+					pn = cpn;
+					best = i;
+					best_dn = cdn;
+				} else if (cpn < second) {
+					second = cpn;
+				}
+			} else {
+				pn = add(pn, cpn);
+				if (cdn < dn) {
+					second = dn;
+					dn = cdn;
+					best = i;
+					best_pn = cpn;
+				} else if (cdn < second) {
+					second = cdn;
+				}
+			}
+		}
+		if (pn >= thpn || dn >= thdn || s->nodes >= s->node_limit) {
+			break;
+		}
+
+		if (or_node) {
+			child_thpn = (second < thpn - 1) ? second + 1 : thpn;
+			child_thdn = thdn - dn + best_dn;
+		} else {
+			child_thdn = (second < thdn - 1) ? second + 1 : thdn;
+			child_thpn = thpn - pn + best_pn;
+		}
+		fc_board_copy(&child, board);
+		if (fc_mlist_length(list)) {
+			fc_board_make_move(&child, fc_mlist_get(list, best));
+		}
+		mid(s, &child, next_player(&child, to_move), keys[best],
+				ply + 1, child_thpn, child_thdn);
+		if (s->aborted) {
+			break;
+		}
+	}
+
+	/* the entry may have been moved by a lookup further down */
+	if ((e = store(s, key)) != NULL) {
+		e->pn = pn;
+		e->dn = dn;
+		e->path_dependent = (dn == 0 && pd);
+		e->work = s->nodes - start;
+		e->on_path = 0;
+	}
+	free(keys);
+	free(results);
+}
+
+int fc_ai_solve (fc_ai_t *ai, fc_player_t player, unsigned long node_limit,
+		unsigned long memory, fc_move_t *move)
+{
+	int i, n, rc, pd;
+	int *results;
+	uint32_t pn, dn;
+	uint64_t key, *keys;
+	solver_t s;
+	entry_t *e;
+
+	assert(ai && ai->board);
+	if (fc_board_is_player_out(ai->board, player)) {
+		return FC_SOLVE_UNKNOWN;
+	}
+	if (fc_board_game_over(ai->board)) {
+		return (fc_board_is_player_out(ai->board, FC_PARTNER(player))) ?
+			FC_SOLVE_DISPROVEN : FC_SOLVE_PROVEN;
+	}
+
+	memory = (memory) ? memory : DEFAULT_MEMORY;
+	for (s.size = 1; s.size * 2 * sizeof(entry_t) <= memory ||
+			s.size < MIN_ENTRIES; s.size *= 2)
+		;
+	s.table = calloc(s.size, sizeof(entry_t));
+	if (!s.table) {
+		return FC_SOLVE_UNKNOWN;
+	}
+	s.nodes = 0;
+	s.node_limit = (node_limit) ? node_limit : (unsigned long)-1;
+	s.player = player;
+	s.replaced = 0;
+	s.aborted = 0;
+	for (i = 0; i < FC_SOLVE_MAX_PLIES; i++) {
+		fc_mlist_init(&(s.lists[i]));
+	}
+
+	key = fc_ai_node_key(ai->board, player);
+	mid(&s, ai->board, player, key, 0, INFINITE_PN, INFINITE_PN);
+
+	rc = FC_SOLVE_UNKNOWN;
+	e = (s.aborted) ? NULL : lookup(&s, key);
+	if (e && e->pn == 0) {
+		rc = FC_SOLVE_PROVEN;
+		n = expand(&s, ai->board, player, 0, &keys, &results);
+		for (i = 0; i < n && move; i++) {
+			child_numbers(&s, keys[i], results[i], &pn, &dn, &pd);
+			if (pn == 0) {
+				fc_move_copy(move, fc_mlist_get(&(s.lists[0]),
+							i));
+				break;
+			}
+		}
+		free(keys);
+		free(results);
+		if (s.aborted) {
+			rc = FC_SOLVE_UNKNOWN;
+		}
+	} else if (e && e->dn == 0 && !e->path_dependent) {
+		rc = FC_SOLVE_DISPROVEN;
+	}
+
+	for (i = 0; i < FC_SOLVE_MAX_PLIES; i++) {
+		fc_mlist_free(&(s.lists[i]));
+	}
+	free(s.table);
+	return rc;
+}
@@ -0,0 +1,424 @@
+/*
+ * LibForchess
+ * Copyright (c) 2011, Jason M Barnes
+ *
+ * This file is subject to the terms and conditions of the 'LICENSE' file
+ * which is a part of this source code package.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Searches that run in a background thread.  A ponder search has an AI
+ * structure of its own, so that it shares nothing with the caller's AI but
+ * the stop flag.  The caller's transposition table and move ordering
+ * history are handed over to it while it runs (see lend_tables()).  An
+ * asynchronous search borrows the caller's AI, which is left alone until
+ * fc_ai_search_wait().  In both cases, the results are only read after the
+ * thread has been joined.
+ */
+
+/* needed for the pthreads API under -std=c89 */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "forchess/ai.h"
+#include "forchess/board.h"
+#include "forchess/moves.h"
+
+/* the depth used to predict a move that the principal variation does not */
+#define PREDICT_DEPTH 4
+
+struct fc_ai_thread_ {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	int stop; /* guarded by lock */
+	int done; /* guarded by lock */
+	fc_ai_t *ai; /* the AI that runs the search */
+	fc_player_t player;
+	int max_depth;
+	unsigned int seconds;
+	fc_mlist_t best; /* ranked moves of the deepest finished search */
+	int depth; /* depth of best; 0 if no search has finished; guarded by
+		      lock while the thread runs */
+	/* used by the ponder thread only */
+	fc_ai_t own_ai;
+	fc_board_t board; /* the predicted position */
+	fc_move_t line[FC_AI_MAX_PV]; /* the predicted moves of the opponents */
+	int line_length;
+};
+
+static fc_ai_thread_t *new_thread (fc_ai_t *ai, fc_player_t player,
+		int depth)
+{
+	fc_ai_thread_t *t;
+
+	t = malloc(sizeof(fc_ai_thread_t));
+	if (!t) {
+		return NULL;
+	}
+	pthread_mutex_init(&(t->lock), NULL);
+	t->stop = 0;
+	t->done = 0;
+	t->ai = ai;
+	t->player = player;
+	t->max_depth = depth;
+	t->seconds = 0;
+	fc_mlist_init(&(t->best));
+	t->depth = 0;
+	return t;
+}
+
+static void free_thread (fc_ai_thread_t *t)
+{
+	if (t->ai == &(t->own_ai)) {
+		fc_ai_free(t->ai);
+	}
+	fc_mlist_free(&(t->best));
+	pthread_mutex_destroy(&(t->lock));
+	free(t);
+}
+
+static void stop_thread (fc_ai_thread_t *t)
+{
+	pthread_mutex_lock(&(t->lock));
+	t->stop = 1;
+	pthread_mutex_unlock(&(t->lock));
+}
+
+int fc_ai_thread_stopping (fc_ai_thread_t *t)
+{
+	int stop;
+
+	pthread_mutex_lock(&(t->lock));
+	stop = t->stop;
+	pthread_mutex_unlock(&(t->lock));
+	return stop;
+}
+
+static fc_player_t next_player (fc_board_t *board, fc_player_t player)
+{
+	int i;
+
+	for (i = 0; i < FC_NUM_PLAYERS; i++) {
+		player = FC_NEXT_PLAYER(player);
+		if (!fc_board_is_player_out(board, player)) {
+			break;
+		}
+	}
+	return player;
+}
+
+static int same_position (fc_board_t *a, fc_board_t *b)
+{
+	return !memcmp(a->bitb, b->bitb, sizeof(a->bitb));
+}
+
+/*
+ * Plays the opponents' moves on the thread's board until it is the
+ * player's turn again.  The moves come from the principal variation while it
+ * lasts, and from a shallow search after that.
+ */
+static void play_predicted_moves (fc_ai_thread_t *t)
+{
+	int i;
+	fc_move_t move;
+	fc_player_t to_move;
+
+	i = 0;
+	to_move = next_player(&(t->board), t->player);
+	while (to_move != t->player && !fc_board_game_over(&(t->board)) &&
+			!fc_ai_thread_stopping(t)) {
+		if (i < t->line_length && t->line[i].player == to_move) {
+			fc_move_copy(&move, &(t->line[i++]));
+		} else {
+			i = t->line_length;
+			if (!fc_ai_next_move(t->ai, &move, NULL, to_move,
+						PREDICT_DEPTH, 0)) {
+				return;
+			}
+		}
+		fc_board_make_move(&(t->board), &move);
+		to_move = next_player(&(t->board), to_move);
+	}
+}
+
+static void set_depth (fc_ai_thread_t *t, int depth)
+{
+	pthread_mutex_lock(&(t->lock));
+	t->depth = depth;
+	pthread_mutex_unlock(&(t->lock));
+}
+
+static void record_depth (void *data, int depth, int score,
+		unsigned long nodes, fc_move_t *move)
+{
+	set_depth(data, depth);
+}
+
+/*
+ * The ponder search starts from what the caller's AI has learned so far:
+ * its transposition table, which is handed over rather than copied, and its
+ * killer moves, history scores and MTD(f) guesses.
+ */
+static void lend_tables (fc_ai_t *to, fc_ai_t *from)
+{
+	free(to->hash);
+	to->hash = from->hash;
+	to->hash_size = from->hash_size;
+	from->hash = NULL;
+	from->hash_size = 0;
+	to->age = from->age;
+	memcpy(to->killers, from->killers, sizeof(to->killers));
+	memcpy(to->history, from->history, sizeof(to->history));
+	memcpy(to->guess, from->guess, sizeof(to->guess));
+}
+
+/*
+ * Hands the tables back to the caller's AI once the ponder thread has been
+ * joined, with whatever the ponder search added to them.  If the caller has
+ * changed the size of the table or the beam in the meantime, which would
+ * have cleared the table, they are thrown away instead.
+ */
+static void return_tables (fc_ai_t *ai, fc_ai_thread_t *t)
+{
+	fc_ai_t *own = t->ai;
+
+	if (!ai->hash && ai->hash_memory == own->hash_memory &&
+			ai->beam_opponent == own->beam_opponent &&
+			ai->beam_partner == own->beam_partner) {
+		lend_tables(ai, own);
+	}
+}
+
+/*
+ * The ponder thread.  Searches the predicted position one ply deeper at a
+ * time (see fc_ai_next_ranked_moves()) and keeps the last search to finish.
+ */
+static void *ponder (void *arg)
+{
+	fc_ai_thread_t *t = arg;
+
+	play_predicted_moves(t);
+	if (fc_board_game_over(&(t->board)) ||
+			fc_board_is_player_out(&(t->board), t->player)) {
+		return NULL;
+	}
+
+	fc_ai_set_progress(t->ai, record_depth, t);
+	fc_ai_next_ranked_moves(t->ai, &(t->best), NULL, t->player,
+			t->max_depth, 0);
+	if (t->ai->forced) {
+		set_depth(t, t->max_depth);
+	}
+	return NULL;
+}
+
+/*
+ * Drops the moves of the principal variation that have already been played,
+ * so that the line starts from the current position.  Returns 0 if the
+ * current position is not on the line.
+ */
+static int align_line (fc_ai_thread_t *t, fc_ai_t *ai)
+{
+	int i;
+	fc_board_t board;
+
+	fc_board_copy(&board, &(ai->pv_board));
+	for (i = 0; i < ai->pv_length; i++) {
+		if (same_position(&board, ai->board)) {
+			break;
+		}
+		fc_board_make_move(&board, &(ai->pv[i]));
+	}
+	if (!same_position(&board, ai->board)) {
+		t->line_length = 0;
+		return 0;
+	}
+	t->line_length = ai->pv_length - i;
+	memcpy(t->line, ai->pv + i, t->line_length * sizeof(fc_move_t));
+	return 1;
+}
+
+int fc_ai_ponder (fc_ai_t *ai, fc_player_t player, int depth)
+{
+	fc_ai_thread_t *t;
+
+	assert(ai && ai->board);
+	fc_ai_stop_pondering(ai);
+	if (ai->algo == FC_MCTS || depth < 1 ||
+			fc_board_game_over(ai->board) ||
+			fc_board_is_player_out(ai->board, player)) {
+		return 0;
+	}
+
+	t = new_thread(NULL, player, depth);
+	if (!t) {
+		return 0;
+	}
+	t->ai = &(t->own_ai);
+	fc_board_copy(&(t->board), ai->board);
+	fc_ai_init(t->ai, &(t->board));
+	fc_ai_set_algorithm(t->ai, ai->algo);
+	fc_ai_set_pseudo_legal(t->ai, ai->pseudo_legal);
+	fc_ai_set_futility(t->ai, ai->futility);
+	fc_ai_set_forced_moves(t->ai, ai->forced_moves);
+	fc_ai_set_beam(t->ai, ai->beam_opponent, ai->beam_partner);
+	fc_ai_set_hash_size(t->ai, ai->hash_memory);
+	lend_tables(t->ai, ai);
+	t->ai->thread = t;
+	align_line(t, ai);
+
+	if (pthread_create(&(t->thread), NULL, ponder, t)) {
+		return_tables(ai, t);
+		free_thread(t);
+		return 0;
+	}
+	ai->ponder = t;
+	return 1;
+}
+
+int fc_ai_ponder_depth (fc_ai_t *ai)
+{
+	int depth;
+
+	assert(ai);
+	if (!ai->ponder) {
+		return 0;
+	}
+	pthread_mutex_lock(&(ai->ponder->lock));
+	depth = ai->ponder->depth;
+	pthread_mutex_unlock(&(ai->ponder->lock));
+	return depth;
+}
+
+void fc_ai_stop_pondering (fc_ai_t *ai)
+{
+	assert(ai);
+	if (!ai->ponder) {
+		return;
+	}
+	stop_thread(ai->ponder);
+	pthread_join(ai->ponder->thread, NULL);
+	return_tables(ai, ai->ponder);
+	free_thread(ai->ponder);
+	ai->ponder = NULL;
+}
+
+int fc_ai_collect_ponder (fc_ai_t *ai, fc_player_t player, fc_mlist_t *list)
+{
+	int depth;
+	fc_ai_thread_t *t;
+
+	if (!ai->ponder) {
+		return 0;
+	}
+	t = ai->ponder;
+	stop_thread(t);
+	pthread_join(t->thread, NULL);
+	return_tables(ai, t);
+
+	depth = 0;
+	if (t->depth > 0 && t->player == player &&
+			same_position(&(t->board), ai->board)) {
+		depth = t->depth;
+		fc_mlist_copy(list, &(t->best));
+		memcpy(ai->pv, t->ai->pv, sizeof(ai->pv));
+		ai->pv_length = t->ai->pv_length;
+		fc_board_copy(&(ai->pv_board), &(t->ai->pv_board));
+	}
+	free_thread(t);
+	ai->ponder = NULL;
+	return depth;
+}
+
+/*
+ * The thread of fc_ai_search_start().
+ */
+static void *run_search (void *arg)
+{
+	fc_ai_thread_t *t = arg;
+
+	fc_ai_next_ranked_moves(t->ai, &(t->best), NULL, t->player,
+			t->max_depth, t->seconds);
+	pthread_mutex_lock(&(t->lock));
+	t->done = 1;
+	pthread_mutex_unlock(&(t->lock));
+	return NULL;
+}
+
+int fc_ai_search_start (fc_ai_t *ai, fc_player_t player, int depth,
+		unsigned int seconds)
+{
+	fc_ai_thread_t *t;
+
+	assert(ai && ai->board && !ai->search);
+	if (fc_board_is_player_out(ai->board, player) || depth < 1) {
+		return 0;
+	}
+
+	t = new_thread(ai, player, depth);
+	if (!t) {
+		return 0;
+	}
+	t->seconds = seconds;
+	ai->thread = t;
+	ai->search = t;
+	if (pthread_create(&(t->thread), NULL, run_search, t)) {
+		ai->thread = NULL;
+		ai->search = NULL;
+		free_thread(t);
+		return 0;
+	}
+	return 1;
+}
+
+int fc_ai_search_poll (fc_ai_t *ai)
+{
+	int done;
+
+	assert(ai && ai->search);
+	pthread_mutex_lock(&(ai->search->lock));
+	done = ai->search->done;
+	pthread_mutex_unlock(&(ai->search->lock));
+	return done;
+}
+
+void fc_ai_search_stop (fc_ai_t *ai)
+{
+	assert(ai && ai->search);
+	stop_thread(ai->search);
+}
+
+int fc_ai_search_wait (fc_ai_t *ai, fc_move_t *move)
+{
+	int rc;
+	fc_ai_thread_t *t;
+
+	assert(ai && ai->search);
+	t = ai->search;
+	pthread_join(t->thread, NULL);
+	rc = (fc_mlist_length(&(t->best)) > 0);
+	if (rc && move) {
+		fc_move_copy(move, fc_mlist_get(&(t->best), 0));
+	}
+	ai->thread = NULL;
+	ai->search = NULL;
+	free_thread(t);
+	return rc;
+}
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "forchess/ai.h"
 #include "forchess/board.h"
@@ -31,6 +32,7 @@ START_TEST (test_ai_next_move1)
 	fc_board_make_move(&board, &move);
 	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
 	fail_unless(move.move == fc_uint64("c1-h1"));
+	fc_ai_free(&ai);
 }
 END_TEST
 
@@ -51,10 +53,819 @@ START_TEST (test_ai_next_move2)
 	fc_board_setup(&board, "test/boards/test_ai_next_move.3", &dummy);
 	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
 	fail_unless(move.piece == FC_PAWN);
+	fc_ai_free(&ai);
+}
+END_TEST
+
+/* the principal variation starts with the best move */
+START_TEST (test_ai_get_pv)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_next_move.1", &dummy);
+	fc_move_t move;
+	fc_ai_t ai;
+	fc_ai_init(&ai, &board);
+	fail_unless(fc_ai_get_pv(&ai, &move, 1) == 0);
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
+	fc_move_t line[4];
+	int length = fc_ai_get_pv(&ai, line, 4);
+	fail_unless(length > 1 && length <= 4);
+	fail_unless(line[0].move == move.move);
+	fail_unless(line[1].player == FC_FOURTH);
+	fail_unless(fc_ai_get_pv(&ai, line, 1) == 1);
+
+	/* the next search starts down the predicted line */
+	fc_board_make_move(&board, &line[0]);
+	fc_ai_next_move(&ai, &move, NULL, FC_FOURTH, 4, TEST_AI_TIMEOUT);
+	fail_unless(move.move == fc_uint64("a8-c7"));
+	fc_ai_free(&ai);
+}
+END_TEST
+
+/* the quickest win is scored by its distance from the root; the king
+ * capture would be forced, so the forced moves are searched here */
+START_TEST (test_ai_mate_distance)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_mate_distance.1", &dummy);
+	fc_mlist_t list;
+	fc_mlist_init(&list);
+	fc_ai_t ai;
+	fc_ai_init(&ai, &board);
+	fc_ai_set_forced_moves(&ai, 0);
+	fc_ai_next_ranked_moves(&ai, &list, NULL, FC_FIRST, 4,
+			TEST_AI_TIMEOUT);
+	fail_unless(!fc_ai_was_forced(&ai) && fc_ai_get_nodes(&ai) > 0);
+	fail_unless(fc_mlist_get(&list, 0)->move == fc_uint64("a7-h7"));
+	fail_unless(fc_mlist_get(&list, 0)->value == FC_AI_WIN_SCORE - 1);
+
+	fc_mlist_clear(&list);
+	fc_ai_set_algorithm(&ai, FC_ALPHABETA);
+	fc_ai_next_ranked_moves(&ai, &list, NULL, FC_FIRST, 4,
+			TEST_AI_TIMEOUT);
+	fail_unless(!fc_ai_was_forced(&ai) && fc_ai_get_nodes(&ai) > 0);
+	fail_unless(fc_mlist_get(&list, 0)->move == fc_uint64("a7-h7"));
+	fail_unless(fc_mlist_get(&list, 0)->value == FC_AI_WIN_SCORE - 1);
+	fc_ai_free(&ai);
+
+	/* both king captures win, but the rook's takes three plies longer;
+	 * the king captures it picks up on the way are no reason to prefer it */
+	fc_board_init(&board);
+	fc_board_setup(&board, "test/boards/test_ai_mate_distance.2", &dummy);
+	fc_ai_algo_t algos[] = { FC_NEGASCOUT, FC_MTDF };
+	for (int i = 0; i < 2; i++) {
+		fc_ai_init(&ai, &board);
+		fc_ai_set_algorithm(&ai, algos[i]);
+		fc_mlist_clear(&list);
+		fc_ai_next_ranked_moves(&ai, &list, NULL, FC_FIRST, 5, 0);
+		fail_unless(fc_mlist_get(&list, 0)->move ==
+				fc_uint64("c5-d4"));
+		fail_unless(fc_mlist_get(&list, 0)->value ==
+				FC_AI_WIN_SCORE - 3);
+		fc_ai_free(&ai);
+	}
+	fc_mlist_free(&list);
+}
+END_TEST
+
+/* best-reply search finds the same wins */
+START_TEST (test_ai_brs)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_next_move.1", &dummy);
+	fc_move_t move;
+	fc_ai_t ai;
+	fc_ai_init(&ai, &board);
+	fc_ai_set_algorithm(&ai, FC_BRS);
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
+	fail_unless(move.move == fc_uint64("c8-c1"));
+
+	fc_board_init(&board);
+	fc_board_setup(&board, "test/boards/test_ai_mate_distance.1", &dummy);
+	fc_ai_set_forced_moves(&ai, 0);
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
+	fail_unless(!fc_ai_was_forced(&ai) && fc_ai_get_nodes(&ai) > 0);
+	fail_unless(move.move == fc_uint64("a7-h7"));
+	fc_ai_free(&ai);
+}
+END_TEST
+
+/* MTD(f) converges on the same wins as negascout */
+START_TEST (test_ai_mtdf)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_next_move.1", &dummy);
+	fc_move_t move;
+	fc_ai_t ai;
+	fc_ai_init(&ai, &board);
+	fc_ai_set_algorithm(&ai, FC_MTDF);
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
+	fail_unless(move.move == fc_uint64("c8-c1"));
+
+	fc_board_init(&board);
+	fc_board_setup(&board, "test/boards/test_ai_mate_distance.1", &dummy);
+	fc_mlist_t list;
+	fc_mlist_init(&list);
+	fc_ai_set_forced_moves(&ai, 0);
+	fc_ai_next_ranked_moves(&ai, &list, NULL, FC_FIRST, 4,
+			TEST_AI_TIMEOUT);
+	fail_unless(!fc_ai_was_forced(&ai) && fc_ai_get_nodes(&ai) > 0);
+	fail_unless(fc_mlist_get(&list, 0)->move == fc_uint64("a7-h7"));
+	fail_unless(fc_mlist_get(&list, 0)->value == FC_AI_WIN_SCORE - 1);
+	fc_mlist_free(&list);
+	fc_ai_free(&ai);
+}
+END_TEST
+
+/* max^n finds the quickest king capture */
+START_TEST (test_ai_maxn)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_next_move.1", &dummy);
+	fc_move_t move;
+	fc_ai_t ai;
+	fc_ai_init(&ai, &board);
+	fc_ai_set_algorithm(&ai, FC_MAXN);
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
+	fail_unless(move.move == fc_uint64("c8-c1"));
+
+	fc_board_init(&board);
+	fc_board_setup(&board, "test/boards/test_ai_mate_distance.1", &dummy);
+	fc_ai_set_forced_moves(&ai, 0);
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
+	fail_unless(!fc_ai_was_forced(&ai) && fc_ai_get_nodes(&ai) > 0);
+	fail_unless(move.move == fc_uint64("a7-h7"));
+	fc_ai_free(&ai);
+}
+END_TEST
+
+/* the number of playouts that went through the root's moves */
+static long count_visits (fc_mlist_t *list)
+{
+	long visits = 0;
+	for (int i = 0; i < fc_mlist_length(list); i++) {
+		visits += fc_mlist_get(list, i)->value;
+	}
+	return visits;
+}
+
+/* the monte carlo search finds the king capture that sets up the partner's,
+ * with or without threads, within either budget */
+START_TEST (test_ai_mcts)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_king_capture.1", &dummy);
+	fc_move_t pv[2];
+	fc_mlist_t list;
+	fc_mlist_init(&list);
+	fc_ai_t ai;
+	fc_ai_init(&ai, &board);
+	fc_ai_set_algorithm(&ai, FC_MCTS);
+	for (int threads = 1; threads <= 4; threads += 3) {
+		fc_ai_set_threads(&ai, threads);
+		fc_ai_set_mcts_budget(&ai, 20000, 0);
+		fc_mlist_clear(&list);
+		fc_ai_next_ranked_moves(&ai, &list, NULL, FC_FIRST, 8,
+				TEST_AI_TIMEOUT);
+		fail_unless(!fc_ai_was_forced(&ai));
+		fail_unless(fc_mlist_length(&list) > 1);
+		fail_unless(fc_mlist_get(&list, 0)->move ==
+				fc_uint64("a5-a8"));
+		fail_unless(count_visits(&list) == 20000);
+		fail_unless(fc_ai_get_pv(&ai, pv, 2) >= 1);
+		fail_unless(pv[0].move == fc_mlist_get(&list, 0)->move);
+	}
+
+	/* the time budget stops the playouts */
+	fc_ai_set_mcts_budget(&ai, 0, 200);
+	fc_mlist_clear(&list);
+	time_t start = time(NULL);
+	fc_ai_next_ranked_moves(&ai, &list, NULL, FC_FIRST, 8,
+			TEST_AI_TIMEOUT);
+	fail_unless(time(NULL) - start <= 1);
+	fail_unless(count_visits(&list) > 0);
+	fail_unless(fc_mlist_get(&list, 0)->move == fc_uint64("a5-a8"));
+	fc_mlist_free(&list);
+	fc_ai_free(&ai);
+}
+END_TEST
+
+/* the solver proves wins, disproves losses, and stops at its node limit */
+START_TEST (test_ai_solve)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_next_move.1", &dummy);
+	fc_move_t move;
+	fc_ai_t ai;
+	fc_ai_init(&ai, &board);
+	fail_unless(fc_ai_solve(&ai, FC_FIRST, 100000, 0, &move) ==
+			FC_SOLVE_PROVEN);
+	fail_unless(move.player == FC_FIRST);
+	fail_unless(move.piece == FC_ROOK);
+	/* a small table still finds the proof */
+	fail_unless(fc_ai_solve(&ai, FC_FIRST, 100000, 65536, NULL) ==
+			FC_SOLVE_PROVEN);
+	/* one too small for it gives up, even without a node limit */
+	fail_unless(fc_ai_solve(&ai, FC_FIRST, 0, 1, NULL) ==
+			FC_SOLVE_UNKNOWN);
+
+	fc_board_init(&board);
+	fc_board_setup(&board, "test/boards/test_ai_next_move.3", &dummy);
+	fail_unless(fc_ai_solve(&ai, FC_FIRST, 100000, 0, &move) ==
+			FC_SOLVE_DISPROVEN);
+	/* a disproof that rests on repeating a position holds only for the
+	 * line that repeated it */
+	fc_board_init(&board);
+	fc_board_setup(&board, "test/boards/test_ai_solve.1", &dummy);
+	fail_unless(fc_ai_solve(&ai, FC_FIRST, 100000, 0, &move) ==
+			FC_SOLVE_UNKNOWN);
+
+	fc_board_init(&board);
+	fc_board_setup(&board, "test/boards/test_ai_next_move.2", &dummy);
+	fail_unless(fc_ai_solve(&ai, FC_FIRST, 100, 0, &move) ==
+			FC_SOLVE_UNKNOWN);
+	fc_ai_free(&ai);
 }
 END_TEST
 
 #define TEST_TIMEOUT_SECS 4
+START_TEST (test_ai_forced_move)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_move_t move;
+	fc_ai_t ai;
+	fc_ai_init(&ai, &board);
+	/* the only remove is the king */
+	fc_board_setup(&board,
+			"test/boards/test_forchess_board_get_valid_removes.1",
+			&dummy);
+	fail_unless(fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 8,
+				TEST_AI_TIMEOUT));
+	fail_unless(fc_ai_was_forced(&ai));
+	fail_unless(fc_ai_get_nodes(&ai) == 0);
+	fail_unless(move.move == 1);
+	/* a king capture that ends the game */
+	fc_board_init(&board);
+	fc_board_setup(&board, "test/boards/test_ai_mate_distance.1", &dummy);
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 8, TEST_AI_TIMEOUT);
+	fail_unless(fc_ai_was_forced(&ai));
+	fail_unless(move.move == fc_uint64("a7-h7"));
+	/* but not with the check turned off */
+	fc_ai_set_forced_moves(&ai, 0);
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 8, TEST_AI_TIMEOUT);
+	fail_unless(!fc_ai_was_forced(&ai));
+	fail_unless(fc_ai_get_nodes(&ai) > 0);
+	fail_unless(move.move == fc_uint64("a7-h7"));
+	fc_ai_set_forced_moves(&ai, 1);
+	/* a king with two ways to go is searched */
+	fc_board_init(&board);
+	fc_board_setup(&board, "test/boards/test_ai_forced_move.1", &dummy);
+	fc_mlist_t list;
+	fc_mlist_init(&list);
+	fc_board_get_moves(&board, &list, FC_FIRST);
+	fail_unless(fc_mlist_length(&list) == 2);
+	fc_mlist_clear(&list);
+	fc_ai_next_ranked_moves(&ai, &list, NULL, FC_FIRST, 4,
+			TEST_AI_TIMEOUT);
+	fail_unless(!fc_ai_was_forced(&ai));
+	fail_unless(fc_ai_get_nodes(&ai) > 0);
+	fail_unless(fc_mlist_length(&list) == 2);
+	fc_mlist_free(&list);
+	/* as is anything else */
+	fc_board_init(&board);
+	fc_board_setup(&board, "test/boards/test_ai_timeout.1", &dummy);
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 2, TEST_AI_TIMEOUT);
+	fail_unless(!fc_ai_was_forced(&ai));
+	fail_unless(fc_ai_get_nodes(&ai) > 0);
+	fc_ai_free(&ai);
+}
+END_TEST
+
+static int is_legal (fc_board_t *board, fc_move_t *move)
+{
+	fc_mlist_t list;
+	fc_mlist_init(&list);
+	fc_board_get_moves(board, &list, move->player);
+	int i, found = 0;
+	for (i = 0; i < fc_mlist_length(&list); i++) {
+		if (fc_mlist_get(&list, i)->move == move->move) {
+			found = 1;
+		}
+	}
+	fc_mlist_free(&list);
+	return found;
+}
+
+static int progress_calls, progress_depth;
+
+static void count_progress (void *data, int depth, int score,
+		unsigned long nodes, fc_move_t *move)
+{
+	progress_calls += 1;
+	fail_unless(depth == progress_depth + 1);
+	fail_unless(nodes > 0 && move != NULL);
+	progress_depth = depth;
+}
+
+/* waits for the ponder thread to finish the given depth */
+static void wait_for_ponder (fc_ai_t *ai, int depth)
+{
+	for (int i = 0; i < 60 && fc_ai_ponder_depth(ai) < depth; i++) {
+		sleep(1);
+	}
+	fail_unless(fc_ai_ponder_depth(ai) == depth);
+}
+
+START_TEST (test_ai_ponder)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_timeout.1", &dummy);
+	fc_move_t move, line[4];
+	fc_ai_t ai;
+	fc_ai_init(&ai, &board);
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
+	fail_unless(fc_ai_get_pv(&ai, line, 4) == 4);
+	fc_board_make_move(&board, &move);
+	fail_unless(fc_ai_ponder(&ai, FC_FIRST, 4));
+
+	/* the opponents play as predicted, so the work is reused */
+	int i;
+	wait_for_ponder(&ai, 4);
+	for (i = 1; i < 4; i++) {
+		fc_board_make_move(&board, &line[i]);
+	}
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
+	fail_unless(fc_ai_get_nodes(&ai) == 0);
+	fail_unless(is_legal(&board, &move));
+
+	/* and the table it filled comes back with it */
+	fc_ai_t fresh;
+	fc_ai_init(&fresh, &board);
+	fc_ai_next_move(&fresh, &move, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
+	fail_unless(fc_ai_get_nodes(&ai) > 0);
+	fail_unless(fc_ai_get_nodes(&ai) < fc_ai_get_nodes(&fresh) / 2);
+	fc_ai_free(&fresh);
+
+	/* a deeper search picks up a ply past the ponder search */
+	fail_unless(fc_ai_get_pv(&ai, line, 4) == 4);
+	fc_board_make_move(&board, &move);
+	fail_unless(fc_ai_ponder(&ai, FC_FIRST, 3));
+	wait_for_ponder(&ai, 3);
+	for (i = 1; i < 4; i++) {
+		fc_board_make_move(&board, &line[i]);
+	}
+	fc_ai_set_progress(&ai, count_progress, NULL);
+	progress_calls = 0;
+	progress_depth = 3;
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
+	fail_unless(progress_calls == 1 && progress_depth == 4);
+	fail_unless(fc_ai_get_nodes(&ai) > 0);
+	fail_unless(is_legal(&board, &move));
+	fc_ai_set_progress(&ai, NULL, NULL);
+
+	/* an unexpected move throws it away */
+	fc_board_make_move(&board, &move);
+	fail_unless(fc_ai_get_pv(&ai, line, 4) == 4);
+	fail_unless(fc_ai_ponder(&ai, FC_FIRST, 4));
+	fc_mlist_t list;
+	fc_mlist_init(&list);
+	fc_board_get_moves(&board, &list, FC_SECOND);
+	for (i = 0; i < fc_mlist_length(&list); i++) {
+		if (fc_mlist_get(&list, i)->move != line[1].move) {
+			fc_board_make_move(&board, fc_mlist_get(&list, i));
+			break;
+		}
+	}
+	fc_mlist_free(&list);
+	fc_board_make_move(&board, &line[2]);
+	fc_board_make_move(&board, &line[3]);
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
+	fail_unless(fc_ai_get_nodes(&ai) > 0);
+	fail_unless(is_legal(&board, &move));
+	fc_ai_stop_pondering(&ai);
+	fc_ai_free(&ai);
+}
+END_TEST
+
+START_TEST (test_ai_search_async)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_timeout.1", &dummy);
+	fc_move_t move;
+	fc_ai_t ai;
+	fc_ai_init(&ai, &board);
+	fc_ai_set_progress(&ai, count_progress, NULL);
+
+	/* a shallow search runs to the end */
+	progress_calls = progress_depth = 0;
+	fail_unless(fc_ai_search_start(&ai, FC_FIRST, 3, 0));
+	while (!fc_ai_search_poll(&ai)) {
+		sleep(1);
+	}
+	fail_unless(fc_ai_search_wait(&ai, &move));
+	fail_unless(progress_calls == 3);
+	fail_unless(is_legal(&board, &move));
+
+	/* a deep one is stopped with the best move so far */
+	progress_calls = progress_depth = 0;
+	fail_unless(fc_ai_search_start(&ai, FC_FIRST, 64, 0));
+	sleep(1);
+	fail_unless(!fc_ai_search_poll(&ai));
+	fc_ai_search_stop(&ai);
+	fail_unless(fc_ai_search_wait(&ai, &move));
+	fail_unless(progress_calls > 0);
+	fail_unless(is_legal(&board, &move));
+	fc_ai_free(&ai);
+}
+END_TEST
+
+START_TEST (test_ai_slice)
+{
+	int i, done[2];
+	const char *files[2] = { "test/boards/test_ai_timeout.1",
+		"test/boards/test_ai_next_move.1" };
+	fc_board_t board[2];
+	fc_player_t dummy;
+	fc_ai_t ai[2], whole;
+	fc_mlist_t moves[2], expected;
+
+	fc_mlist_init(&expected);
+	for (i = 0; i < 2; i++) {
+		fc_board_init(&board[i]);
+		fc_board_setup(&board[i], files[i], &dummy);
+		fc_ai_init(&ai[i], &board[i]);
+		fc_mlist_init(&moves[i]);
+		fail_unless(fc_ai_slice_start(&ai[i], NULL, FC_FIRST, 5));
+		done[i] = 0;
+	}
+
+	/* take turns searching the two games a few nodes at a time */
+	while (!done[0] || !done[1]) {
+		for (i = 0; i < 2; i++) {
+			if (!done[i]) {
+				done[i] = fc_ai_slice_run(&ai[i], 100);
+			}
+		}
+	}
+
+	/* each gives just what the recursive search would have */
+	for (i = 0; i < 2; i++) {
+		unsigned long nodes = fc_ai_get_nodes(&ai[i]);
+		fail_unless(fc_ai_slice_finish(&ai[i], &moves[i]));
+		if (i > 0) {
+			fc_ai_free(&whole);
+		}
+		fc_ai_init(&whole, &board[i]);
+		fc_mlist_clear(&expected);
+		fc_ai_next_ranked_moves(&whole, &expected, NULL, FC_FIRST, 5,
+				0);
+		fail_unless(nodes > 100 && fc_ai_get_nodes(&whole) == nodes);
+		fail_unless(fc_mlist_length(&moves[i]) ==
+				fc_mlist_length(&expected));
+		for (int j = 0; j < fc_mlist_length(&expected); j++) {
+			fc_move_t *a = fc_mlist_get(&moves[i], j);
+			fc_move_t *b = fc_mlist_get(&expected, j);
+			fail_unless(a->move == b->move && a->value == b->value);
+		}
+		fc_mlist_free(&moves[i]);
+	}
+
+	/* a search that is finished early is thrown away */
+	fc_ai_free(&whole);
+	fc_ai_init(&whole, &board[0]);
+	fail_unless(fc_ai_slice_start(&whole, NULL, FC_FIRST, 5));
+	fail_unless(!fc_ai_slice_run(&whole, 100));
+	fc_mlist_clear(&expected);
+	fail_unless(!fc_ai_slice_finish(&whole, &expected));
+	fail_unless(fc_mlist_length(&expected) == 0);
+	fc_mlist_free(&expected);
+	fc_ai_free(&whole);
+	fc_ai_free(&ai[0]);
+	fc_ai_free(&ai[1]);
+}
+END_TEST
+
+/* a player who is far behind heads for a repeated position */
+START_TEST (test_ai_repetition)
+{
+	fc_board_t board, copy;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_repetition.1", &dummy);
+	fc_move_t move = { FC_FIRST, FC_ROOK, FC_NONE, FC_NONE, FC_NONE,
+		fc_uint64("d4-d5"), 0 };
+	fc_board_copy(&copy, &board);
+	fc_board_make_move(&copy, &move);
+	uint64_t key = fc_ai_node_key(&copy, FC_SECOND);
+	fc_ai_algo_t algos[] = { FC_ALPHABETA, FC_NEGASCOUT };
+
+	for (int i = 0; i < 2; i++) {
+		fc_mlist_t list;
+		fc_mlist_init(&list);
+		fc_ai_t ai;
+		fc_ai_init(&ai, &board);
+		fc_ai_set_algorithm(&ai, algos[i]);
+		fc_ai_next_ranked_moves(&ai, &list, NULL, FC_FIRST, 2, 0);
+		fail_unless(fc_mlist_get(&list, 0)->value < 0);
+		fail_unless(fc_mlist_get(&list, 0)->move != move.move);
+
+		fc_ai_set_played_positions(&ai, &key, 1);
+		fc_mlist_clear(&list);
+		fc_ai_next_ranked_moves(&ai, &list, NULL, FC_FIRST, 2, 0);
+		fail_unless(fc_mlist_get(&list, 0)->value == 0);
+		fail_unless(fc_mlist_get(&list, 0)->move == move.move);
+		fc_mlist_free(&list);
+		fc_ai_free(&ai);
+	}
+}
+END_TEST
+
+/* with the fourth seat empty, the third player is followed by his partner */
+START_TEST (test_ai_three_players)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_three_players.1", &dummy);
+	fail_unless(fc_board_num_players(&board) == 3);
+	fc_ai_algo_t algos[] = { FC_ALPHABETA, FC_NEGASCOUT };
+
+	for (int i = 0; i < 2; i++) {
+		fc_mlist_t list;
+		fc_mlist_init(&list);
+		fc_ai_t ai;
+		fc_ai_init(&ai, &board);
+		fc_ai_set_algorithm(&ai, algos[i]);
+		fc_ai_next_ranked_moves(&ai, &list, NULL, FC_THIRD, 2, 0);
+		fail_unless(fc_mlist_get(&list, 0)->piece == FC_KNIGHT);
+		fail_unless(fc_mlist_get(&list, 0)->value ==
+				FC_AI_WIN_SCORE - 2);
+		fc_mlist_free(&list);
+		fc_ai_free(&ai);
+	}
+
+	fc_mlist_t list;
+	fc_mlist_init(&list);
+	fc_ai_t ai;
+	fc_ai_init(&ai, &board);
+	fail_unless(fc_ai_slice_start(&ai, NULL, FC_THIRD, 2));
+	fail_unless(fc_ai_slice_run(&ai, 0));
+	fail_unless(fc_ai_slice_finish(&ai, &list));
+	fail_unless(fc_mlist_get(&list, 0)->piece == FC_KNIGHT);
+	fail_unless(fc_mlist_get(&list, 0)->value == FC_AI_WIN_SCORE - 2);
+	fc_mlist_free(&list);
+	fc_ai_free(&ai);
+}
+END_TEST
+
+/* the check is searched a ply deeper, which brings the king capture into
+ * a search of two plies */
+START_TEST (test_ai_extensions)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_extensions.1", &dummy);
+	fc_mlist_t list;
+	fc_mlist_init(&list);
+	fc_ai_t ai;
+	fc_ai_init(&ai, &board);
+	fc_ai_next_ranked_moves(&ai, &list, NULL, FC_FIRST, 2, 0);
+	fail_unless(fc_mlist_get(&list, 0)->value == FC_AI_WIN_SCORE - 3);
+	fc_mlist_free(&list);
+	fc_ai_free(&ai);
+
+	fc_mlist_init(&list);
+	fc_ai_init(&ai, &board);
+	fail_unless(fc_ai_slice_start(&ai, NULL, FC_FIRST, 2));
+	fail_unless(fc_ai_slice_run(&ai, 0));
+	fail_unless(fc_ai_slice_finish(&ai, &list));
+	fail_unless(fc_mlist_get(&list, 0)->value == FC_AI_WIN_SCORE - 3);
+	fc_mlist_free(&list);
+	fc_ai_free(&ai);
+}
+END_TEST
+
+/* a king capture is worth the same to every search of the same depth */
+START_TEST (test_ai_king_capture)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_king_capture.1", &dummy);
+	fc_ai_algo_t algos[] = { FC_ALPHABETA, FC_NEGASCOUT, FC_MTDF };
+
+	for (int depth = 4; depth <= 6; depth += 2) {
+		int value[3];
+		for (int i = 0; i < 3; i++) {
+			fc_mlist_t list;
+			fc_mlist_init(&list);
+			fc_ai_t ai;
+			fc_ai_init(&ai, &board);
+			fc_ai_set_algorithm(&ai, algos[i]);
+			fc_ai_next_ranked_moves(&ai, &list, NULL, FC_FIRST,
+					depth, 0);
+			fail_unless(fc_mlist_get(&list, 0)->opp_piece ==
+					FC_KING);
+			value[i] = fc_mlist_get(&list, 0)->value;
+			fc_mlist_free(&list);
+			fc_ai_free(&ai);
+		}
+		fail_unless(value[1] == value[0] && value[2] == value[0]);
+	}
+}
+END_TEST
+
+/* the pseudo-legal moves give the same search as the valid ones */
+START_TEST (test_ai_pseudo_legal)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_timeout.1", &dummy);
+	fc_mlist_t list1, list2;
+	fc_mlist_init(&list1);
+	fc_mlist_init(&list2);
+	fc_ai_t ai1, ai2;
+	fc_ai_init(&ai1, &board);
+	fc_ai_init(&ai2, &board);
+	fc_ai_set_pseudo_legal(&ai2, 1);
+	fc_ai_next_ranked_moves(&ai1, &list1, NULL, FC_FIRST, 5, 0);
+	fc_ai_next_ranked_moves(&ai2, &list2, NULL, FC_FIRST, 5, 0);
+	fail_unless(fc_ai_get_nodes(&ai1) == fc_ai_get_nodes(&ai2));
+	fail_unless(fc_mlist_length(&list1) == fc_mlist_length(&list2));
+	for (int i = 0; i < fc_mlist_length(&list1); i++) {
+		fail_unless(fc_mlist_get(&list1, i)->move ==
+				fc_mlist_get(&list2, i)->move);
+		fail_unless(fc_mlist_get(&list1, i)->value ==
+				fc_mlist_get(&list2, i)->value);
+	}
+	fc_mlist_free(&list1);
+	fc_mlist_free(&list2);
+	fc_ai_free(&ai1);
+	fc_ai_free(&ai2);
+}
+END_TEST
+
+/* in the quiet opening position, pruning near the leaves saves nodes
+ * without changing the move or its value */
+START_TEST (test_ai_futility)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_timeout.1", &dummy);
+	fc_mlist_t list1, list2;
+	fc_mlist_init(&list1);
+	fc_mlist_init(&list2);
+	fc_ai_t ai1, ai2;
+	fc_ai_init(&ai1, &board);
+	fc_ai_init(&ai2, &board);
+	fc_ai_set_futility(&ai2, 0);
+	fc_ai_next_ranked_moves(&ai1, &list1, NULL, FC_FIRST, 5, 0);
+	fc_ai_next_ranked_moves(&ai2, &list2, NULL, FC_FIRST, 5, 0);
+	fail_unless(fc_ai_get_nodes(&ai1) < fc_ai_get_nodes(&ai2));
+	fail_unless(fc_mlist_get(&list1, 0)->move ==
+			fc_mlist_get(&list2, 0)->move);
+	fail_unless(fc_mlist_get(&list1, 0)->value ==
+			fc_mlist_get(&list2, 0)->value);
+	fc_mlist_free(&list1);
+	fc_mlist_free(&list2);
+	fc_ai_free(&ai1);
+	fc_ai_free(&ai2);
+}
+END_TEST
+
+/* the other players' plies are narrowed, but the root is searched in full */
+START_TEST (test_ai_beam)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_timeout.1", &dummy);
+	fc_mlist_t list1, list2;
+	fc_mlist_init(&list1);
+	fc_mlist_init(&list2);
+	fc_ai_t ai1, ai2;
+	fc_ai_init(&ai1, &board);
+	fc_ai_init(&ai2, &board);
+	fc_ai_set_beam(&ai2, 2, 1);
+	fc_ai_next_ranked_moves(&ai1, &list1, NULL, FC_FIRST, 5, 0);
+	fc_ai_next_ranked_moves(&ai2, &list2, NULL, FC_FIRST, 5, 0);
+	fail_unless(fc_ai_get_nodes(&ai2) < fc_ai_get_nodes(&ai1));
+	fail_unless(fc_mlist_length(&list1) == fc_mlist_length(&list2));
+	fc_mlist_free(&list1);
+	fc_mlist_free(&list2);
+	fc_ai_free(&ai1);
+	fc_ai_free(&ai2);
+}
+END_TEST
+
+START_TEST (test_ai_node_limit)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_timeout.1", &dummy);
+	fc_move_t move1, move2;
+	fc_ai_t ai1, ai2;
+	fc_ai_init(&ai1, &board);
+	fc_ai_init(&ai2, &board);
+	/* the same limit gives the same search (from the same start, since
+	 * what an AI learns carries over to its next search) */
+	fc_ai_set_node_limit(&ai1, 10000);
+	fc_ai_next_move(&ai1, &move1, NULL, FC_FIRST, 12, TEST_AI_TIMEOUT);
+	fail_unless(fc_ai_get_nodes(&ai1) == 10000);
+	fc_ai_set_node_limit(&ai2, 10000);
+	fc_ai_next_move(&ai2, &move2, NULL, FC_FIRST, 12, TEST_AI_TIMEOUT);
+	fail_unless(fc_ai_get_nodes(&ai2) == 10000);
+	fail_unless(move1.move == move2.move);
+	fc_ai_free(&ai1);
+	fc_ai_free(&ai2);
+	/* a search that finishes under the limit counts all of its nodes */
+	fc_ai_init(&ai1, &board);
+	fc_ai_next_move(&ai1, &move1, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
+	unsigned long nodes = fc_ai_get_nodes(&ai1);
+	fail_unless(nodes > 0 && nodes < 10000);
+	fc_ai_init(&ai2, &board);
+	fc_ai_set_node_limit(&ai2, 10000);
+	fc_ai_next_move(&ai2, &move2, NULL, FC_FIRST, 4, TEST_AI_TIMEOUT);
+	fail_unless(fc_ai_get_nodes(&ai2) == nodes);
+	fail_unless(move1.move == move2.move);
+	fc_ai_free(&ai1);
+	fc_ai_free(&ai2);
+}
+END_TEST
+
+START_TEST (test_ai_hash)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_timeout.1", &dummy);
+	fc_move_t move1, move2;
+	fc_ai_t ai;
+	fc_ai_init(&ai, &board);
+	/* the second search of a position picks up where the first left off */
+	fc_ai_next_move(&ai, &move1, NULL, FC_FIRST, 6, TEST_AI_TIMEOUT);
+	unsigned long nodes = fc_ai_get_nodes(&ai);
+	fc_ai_next_move(&ai, &move2, NULL, FC_FIRST, 6, TEST_AI_TIMEOUT);
+	fail_unless(fc_ai_get_nodes(&ai) < nodes);
+	fail_unless(move1.move == move2.move);
+	/* a new table starts from scratch */
+	fc_ai_set_hash_size(&ai, 64 * 1024);
+	fc_ai_next_move(&ai, &move2, NULL, FC_FIRST, 6, TEST_AI_TIMEOUT);
+	fail_unless(fc_ai_get_nodes(&ai) > 0);
+	fail_unless(move1.move == move2.move);
+	fc_ai_free(&ai);
+}
+END_TEST
+
+START_TEST (test_ai_clock)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_next_move.1", &dummy);
+	fc_move_t move;
+	fc_ai_t ai;
+	fc_ai_init(&ai, &board);
+	/* the depth is only a cap once the clock is set */
+	fc_ai_set_clock(&ai, 2000, 0, 0);
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 64, TEST_AI_TIMEOUT);
+	fail_unless(move.move == fc_uint64("c8-c1"));
+	/* a short clock is not overrun */
+	fc_board_init(&board);
+	fc_board_setup(&board, "test/boards/test_ai_timeout.1", &dummy);
+	fc_ai_set_clock(&ai, 1000, 0, 1);
+	time_t start = time(NULL);
+	fc_ai_next_move(&ai, &move, NULL, FC_FIRST, 64, TEST_AI_TIMEOUT);
+	fail_unless(time(NULL) - start <= 1);
+	fc_ai_free(&ai);
+}
+END_TEST
+
 START_TEST (test_ai_timeout)
 {
 	printf("    Running test_ai_timeout; this will take a few seconds...");
@@ -72,6 +883,7 @@ START_TEST (test_ai_timeout)
 	fail_unless(finish - start <= TEST_TIMEOUT_SECS);
 	printf("done.\n");
 	fflush(stdout);
+	fc_ai_free(&ai);
 }
 END_TEST
 
@@ -81,6 +893,27 @@ Suite *ai_suite (void)
 	TCase *tc_ai = tcase_create("Core");
 	tcase_add_test(tc_ai, test_ai_next_move1);
 	tcase_add_test(tc_ai, test_ai_next_move2);
+	tcase_add_test(tc_ai, test_ai_get_pv);
+	tcase_add_test(tc_ai, test_ai_mate_distance);
+	tcase_add_test(tc_ai, test_ai_brs);
+	tcase_add_test(tc_ai, test_ai_mtdf);
+	tcase_add_test(tc_ai, test_ai_mcts);
+	tcase_add_test(tc_ai, test_ai_maxn);
+	tcase_add_test(tc_ai, test_ai_solve);
+	tcase_add_test(tc_ai, test_ai_forced_move);
+	tcase_add_test(tc_ai, test_ai_node_limit);
+	tcase_add_test(tc_ai, test_ai_hash);
+	tcase_add_test(tc_ai, test_ai_repetition);
+	tcase_add_test(tc_ai, test_ai_three_players);
+	tcase_add_test(tc_ai, test_ai_extensions);
+	tcase_add_test(tc_ai, test_ai_king_capture);
+	tcase_add_test(tc_ai, test_ai_pseudo_legal);
+	tcase_add_test(tc_ai, test_ai_futility);
+	tcase_add_test(tc_ai, test_ai_beam);
+	tcase_add_test(tc_ai, test_ai_ponder);
+	tcase_add_test(tc_ai, test_ai_search_async);
+	tcase_add_test(tc_ai, test_ai_slice);
+	tcase_add_test(tc_ai, test_ai_clock);
 	tcase_add_test(tc_ai, test_ai_timeout);
 	suite_add_tcase(s, tc_ai);
 	return s;
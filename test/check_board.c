@@ -1,6 +1,7 @@
 #include <check.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "forchess/board.h"
 
@@ -744,6 +745,224 @@ START_TEST (test_board_score_position)
 }
 END_TEST
 
+START_TEST (test_board_score_players)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_ai_score_position.1", &dummy);
+	int scores[FC_NUM_PLAYERS];
+	fc_board_score_players(&board, scores);
+	fail_unless(scores[FC_FIRST] == 305100);
+	fail_unless(scores[FC_SECOND] == 304350);
+	fail_unless(scores[FC_THIRD] == 303600);
+	fail_unless(scores[FC_FOURTH] == 304650);
+}
+END_TEST
+
+static int count_material (fc_board_t *board, fc_player_t player)
+{
+	int ret = 0;
+	for (fc_piece_t i = FC_PAWN; i <= FC_KING; i++) {
+		uint64_t piece, pieces = FC_BITBOARD(board, player, i);
+		FC_FOREACH(piece, pieces) {
+			ret += fc_board_get_material_value(board, i);
+		}
+	}
+	return ret;
+}
+
+static int count_positional (fc_board_t *board, fc_player_t player)
+{
+	int ret = 0;
+	for (fc_piece_t i = FC_PAWN; i <= FC_KING; i++) {
+		uint64_t piece, pieces = FC_BITBOARD(board, player, i);
+		FC_FOREACH(piece, pieces) {
+			fc_player_t seat = (i == FC_PAWN) ?
+				fc_get_pawn_orientation(board, piece) : player;
+			ret += board->pst->value[seat][i][fc_bitscan(piece)];
+		}
+	}
+	return ret;
+}
+
+static int sums_are_counted (fc_board_t *board)
+{
+	for (fc_player_t p = FC_FIRST; p <= FC_FOURTH; p++) {
+		if (board->material[p] != count_material(board, p) ||
+				board->positional[p] !=
+				count_positional(board, p)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+START_TEST (test_board_material)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t player;
+	fc_board_setup(&board, "test/boards/test_forchess_make_move.2",
+			&player);
+	fc_pst_t pst;
+	fc_pst_init(&pst);
+	fc_board_set_pst(&board, &pst);
+	fail_unless(sums_are_counted(&board));
+	fail_unless(fc_board_score_position(&board, FC_FIRST) == 0);
+
+	/* play the best ranked move, which is a capture whenever there is
+	 * one, until the game ends; the sums must keep up with the captures,
+	 * promotions and the pieces that change hands with a king */
+	fc_mlist_t list;
+	fc_mlist_init(&list);
+	int ply, out = 0;
+	for (ply = 0; ply < 1000 && !fc_board_game_over(&board); ply++) {
+		if (!fc_board_is_player_out(&board, player)) {
+			fc_mlist_clear(&list);
+			fc_board_get_moves(&board, &list, player);
+			if (fc_mlist_length(&list) == 0) {
+				break;
+			}
+			fc_move_t *move = fc_mlist_get(&list, 0);
+			out += (move->opp_piece == FC_KING);
+			fc_board_make_move(&board, move);
+			fail_unless(sums_are_counted(&board));
+		}
+		player = FC_NEXT_PLAYER(player);
+	}
+	fail_unless(out > 0);
+
+	/* a remove takes the piece's value away */
+	player = fc_board_is_player_out(&board, FC_FIRST) ? FC_SECOND :
+		FC_FIRST;
+	fc_mlist_clear(&list);
+	fc_board_get_all_removes(&board, &list, player);
+	fc_board_make_move(&board, fc_mlist_get(&list, 0));
+	fail_unless(sums_are_counted(&board));
+	fc_mlist_free(&list);
+
+	fc_board_set_material_value(&board, FC_QUEEN, 10000);
+	fail_unless(sums_are_counted(&board));
+	fc_board_remove_piece(&board, 0, 0);
+	fail_unless(sums_are_counted(&board));
+
+	/* reloading over cleared bitboards, as fc_game_load() does, must not
+	 * keep the old sums */
+	memset(board.bitb, 0, sizeof(board.bitb));
+	fc_board_setup(&board, "test/boards/test_forchess_make_move.2",
+			&player);
+	fail_unless(sums_are_counted(&board));
+}
+END_TEST
+
+START_TEST (test_board_pst)
+{
+	fc_pst_t pst;
+	fc_pst_init(&pst);
+	/* each seat's corner gets the value of a1 */
+	int corner[FC_NUM_PLAYERS] = {0, 56, 63, 7};
+	for (fc_player_t p = FC_FIRST; p <= FC_FOURTH; p++) {
+		for (fc_piece_t i = FC_PAWN; i <= FC_KING; i++) {
+			fail_unless(pst.value[p][i][corner[p]] ==
+					pst.square[i][0]);
+		}
+	}
+	fail_unless(!fc_pst_load(&pst, "test/boards/does_not_exist"));
+
+	/* the table only has a knight on b1, which is a7, g8 and h2 from the
+	 * other seats */
+	fail_unless(fc_pst_load(&pst, "test/boards/test_board_pst.1"));
+	fail_unless(pst.value[FC_FIRST][FC_KNIGHT][1] == 25);
+	fail_unless(pst.value[FC_SECOND][FC_KNIGHT][48] == 25);
+	fail_unless(pst.value[FC_THIRD][FC_KNIGHT][62] == 25);
+	fail_unless(pst.value[FC_FOURTH][FC_KNIGHT][15] == 25);
+	fail_unless(pst.value[FC_FIRST][FC_PAWN][1] == 0);
+
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_board_set_piece(&board, FC_FIRST, FC_KING, 0, 0);
+	fc_board_set_piece(&board, FC_FIRST, FC_KNIGHT, 0, 1);
+	fc_board_set_piece(&board, FC_SECOND, FC_KING, 7, 0);
+	fc_board_set_piece(&board, FC_SECOND, FC_KNIGHT, 6, 0);
+	fc_board_set_pst(&board, &pst);
+	fail_unless(fc_board_score_position(&board, FC_FIRST) == 0);
+	fc_move_t move;
+	move.player = FC_FIRST;
+	move.piece = FC_KNIGHT;
+	move.opp_player = FC_NONE;
+	move.opp_piece = FC_NONE;
+	move.promote = FC_NONE;
+	move.move = fc_uint64("b1-c3");
+	fc_board_make_move(&board, &move);
+	fail_unless(fc_board_score_position(&board, FC_FIRST) == -25);
+	fc_board_set_pst(&board, NULL);
+	fail_unless(fc_board_score_position(&board, FC_FIRST) == 0);
+}
+END_TEST
+
+START_TEST (test_board_bits)
+{
+	fc_bits_init();
+	fail_unless(fc_popcount(0) == 0);
+	fail_unless(fc_bitscan(1) == 0);
+	fail_unless(fc_bitscan(((uint64_t)1) << 63) == 63);
+	fail_unless(fc_popcount(~((uint64_t)0)) == 64);
+
+	/* compare against a bit at a time over some scattered bitboards */
+	uint64_t bb = 0x9E3779B97F4A7C15ull;
+	for (int i = 0; i < 100; i++) {
+		bb = bb * 6364136223846793005ull + 1442695040888963407ull;
+		uint64_t x = bb >> (i % 64);
+		int count = 0, lowest = -1;
+		for (int j = 63; j >= 0; j--) {
+			if (x & (((uint64_t)1) << j)) {
+				count++;
+				lowest = j;
+			}
+		}
+		fail_unless(fc_popcount(x) == count);
+		fail_unless(!x || fc_bitscan(x) == lowest);
+	}
+}
+END_TEST
+
+START_TEST (test_board_see)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_board_see.1", &dummy);
+	fc_move_t move;
+	/* (1) the queen takes a pawn that the next player defends */
+	move.player = FC_FIRST;
+	move.piece = FC_QUEEN;
+	move.opp_player = FC_SECOND;
+	move.opp_piece = FC_PAWN;
+	move.promote = FC_NONE;
+	move.move = fc_uint64("d1-d5");
+	fail_unless(fc_board_see(&board, &move) == -800);
+	/* (2) the partner backs up the rook, so the fourth player does not
+	 * recapture */
+	move.piece = FC_ROOK;
+	move.opp_piece = FC_KNIGHT;
+	move.move = fc_uint64("e2-e6");
+	fail_unless(fc_board_see(&board, &move) == 350);
+	/* (3) the fourth player recaptures first, then the first player */
+	move.player = FC_THIRD;
+	move.piece = FC_QUEEN;
+	move.move = fc_uint64("e8-e6");
+	fail_unless(fc_board_see(&board, &move) == -50);
+	/* (4) a quiet move to a safe square */
+	move.player = FC_FIRST;
+	move.piece = FC_ROOK;
+	move.opp_player = FC_NONE;
+	move.opp_piece = FC_NONE;
+	move.move = fc_uint64("e2-e3");
+	fail_unless(fc_board_see(&board, &move) == 0);
+}
+END_TEST
+
 START_TEST (test_board_get_next_move1)
 {
 	/* stolen from test_forchess_board_get_valid_moves1 */
@@ -912,6 +1131,51 @@ START_TEST (test_board_get_next_move5)
 }
 END_TEST
 
+START_TEST (test_board_get_next_move6)
+{
+	fc_board_t board;
+	fc_board_init(&board);
+	fc_player_t dummy;
+	fc_board_setup(&board, "test/boards/test_board_get_next_move.6",
+			&dummy);
+	fc_mlist_t list;
+	fc_mlist_init(&list);
+	fc_board_get_all_moves(&board, &list, FC_FIRST);
+	fc_mlist_iter_t iter;
+	fc_board_state_t state;
+	fc_board_state_init(&state, &board, FC_FIRST);
+	fc_mlist_iter_init(&list, &iter, fc_board_get_next_move);
+	fc_mlist_iter_set_state(&iter, &state);
+	/* each of the three pawn moves is expanded into four promotions, and
+	 * the moves still come out in order */
+	fc_move_t *mp, last;
+	int promotions = 0, knight_capture = -1, queen_capture = -1, i;
+	for (i = 0; fc_mlist_iter_next(&iter); i++) {
+		mp = fc_mlist_iter_get_move(&iter);
+		if (i == 0) {
+			fail_unless(mp->move == fc_uint64("g7-g8"));
+			fail_unless(mp->promote == FC_QUEEN);
+		} else {
+			fail_unless(mp->value <= last.value);
+		}
+		if (mp->piece == FC_PAWN) {
+			fail_unless(mp->promote != FC_NONE);
+			promotions += 1;
+		}
+		if (mp->move == fc_uint64("b3-c5")) {
+			knight_capture = i;
+		} else if (mp->move == fc_uint64("c2-c5")) {
+			queen_capture = i;
+		}
+		fc_move_copy(&last, mp);
+	}
+	fail_unless(promotions == 12);
+	/* the cheaper piece takes the pawn first */
+	fail_unless(knight_capture >= 0 && queen_capture == knight_capture + 1);
+	fc_mlist_free(&list);
+}
+END_TEST
+
 Suite *board_suite (void)
 {
 	Suite *s = suite_create("Board");
@@ -935,11 +1199,17 @@ Suite *board_suite (void)
 	tcase_add_test(tc_board, test_forchess_board_get_valid_removes2);
 	tcase_add_test(tc_board, test_forchess_board_get_valid_removes3);
 	tcase_add_test(tc_board, test_board_score_position);
+	tcase_add_test(tc_board, test_board_score_players);
+	tcase_add_test(tc_board, test_board_material);
+	tcase_add_test(tc_board, test_board_pst);
+	tcase_add_test(tc_board, test_board_bits);
+	tcase_add_test(tc_board, test_board_see);
 	tcase_add_test(tc_board, test_board_get_next_move1);
 	tcase_add_test(tc_board, test_board_get_next_move2);
 	tcase_add_test(tc_board, test_board_get_next_move3);
 	tcase_add_test(tc_board, test_board_get_next_move4);
 	tcase_add_test(tc_board, test_board_get_next_move5);
+	tcase_add_test(tc_board, test_board_get_next_move6);
 	suite_add_tcase(s, tc_board);
 	return s;
 }
@@ -21,6 +21,32 @@ START_TEST (test_move_copy)
 }
 END_TEST
 
+START_TEST (test_move_is_reversible)
+{
+	fc_move_t move;
+	move.player = FC_FIRST;
+	move.piece = FC_ROOK;
+	move.opp_player = FC_NONE;
+	move.opp_piece = FC_NONE;
+	move.promote = FC_NONE;
+	move.move = fc_uint64("d4-d5");
+	fail_unless(fc_move_is_reversible(&move));
+	/* a capture */
+	move.opp_player = FC_SECOND;
+	move.opp_piece = FC_QUEEN;
+	fail_unless(!fc_move_is_reversible(&move));
+	/* a pawn move */
+	move.opp_player = FC_NONE;
+	move.opp_piece = FC_NONE;
+	move.piece = FC_PAWN;
+	fail_unless(!fc_move_is_reversible(&move));
+	/* a remove */
+	move.piece = FC_ROOK;
+	move.move = fc_uint64("d4-d5") & fc_uint64("d4-d3");
+	fail_unless(!fc_move_is_reversible(&move));
+}
+END_TEST
+
 START_TEST (test_mlist_init)
 {
 	fc_mlist_t l1;
@@ -235,6 +261,34 @@ START_TEST (test_mlist_delete)
 }
 END_TEST
 
+START_TEST (test_mlist_insert_from)
+{
+	fc_move_t move;
+	fc_mlist_t list;
+	fail_unless(fc_mlist_init(&list));
+	move.value = 100;
+	fail_unless(fc_mlist_insert(&list, &move, move.value));
+	move.value = 40;
+	fail_unless(fc_mlist_insert(&list, &move, move.value));
+	move.value = 10;
+	fail_unless(fc_mlist_insert(&list, &move, move.value));
+
+	/* the moves before the index are left alone */
+	move.value = 200;
+	fail_unless(fc_mlist_insert_from(&list, 1, &move, move.value));
+	move.value = 20;
+	fail_unless(fc_mlist_insert_from(&list, 1, &move, move.value));
+	move.value = 5;
+	fail_unless(fc_mlist_insert_from(&list, 5, &move, move.value));
+	fail_unless(fc_mlist_get(&list, 0)->value == 100);
+	fail_unless(fc_mlist_get(&list, 1)->value == 200);
+	fail_unless(fc_mlist_get(&list, 2)->value == 40);
+	fail_unless(fc_mlist_get(&list, 3)->value == 20);
+	fail_unless(fc_mlist_get(&list, 4)->value == 10);
+	fail_unless(fc_mlist_get(&list, 5)->value == 5);
+}
+END_TEST
+
 static fc_move_t *test_cb (fc_mlist_iter_t *iter)
 {
 	fc_move_t *ret;
@@ -289,12 +343,14 @@ Suite *move_suite (void)
 	Suite *s = suite_create("Moves");
 	TCase *tc_moves = tcase_create("Core");
 	tcase_add_test(tc_moves, test_move_copy);
+	tcase_add_test(tc_moves, test_move_is_reversible);
 	tcase_add_test(tc_moves, test_mlist_init);
 	tcase_add_test(tc_moves, test_mlist_insert1);
 	tcase_add_test(tc_moves, test_mlist_copy);
 	tcase_add_test(tc_moves, test_mlist_merge);
 	tcase_add_test(tc_moves, test_mlist_insert2);
 	tcase_add_test(tc_moves, test_mlist_delete);
+	tcase_add_test(tc_moves, test_mlist_insert_from);
 	tcase_add_test(tc_moves, test_mlist_iter);
 	suite_add_tcase(s, tc_moves);
 	return s;